@@ -14,11 +14,14 @@ enum Traversal {
 	POSTORDER
 };
 
+struct RBNode;
 
 typedef struct Dtype { // abstract data type, representing pcb_t
     struct pcb_t *proc; // pointer to the process control block
     double key; // key for comparison
     int timestamp;
+    void *item; // payload of trees not holding processes
+    void (*augment)(struct RBNode *node); // recompute the node's subtree value, may be NULL
 } Dtype;
 
 typedef struct RBNode {
@@ -43,6 +46,9 @@ void transplant(RBNode **root, RBNode *u, RBNode *v);
 // Minimum right subtree
 RBNode *minimumRightSubTree(RBNode *node); 
 
+// Recompute augmented values from node up to the root
+void augmentPath(RBNode *node);
+
 // Insertion operations
 void insertNode(RBNode **root, Dtype *data);
 void insertFixup(RBNode **root, RBNode *z); // Fixup after insertion (recoloring and rotations)
@@ -59,5 +65,10 @@ void traverse(RBNode *root, void (*visit)(RBNode *node), enum Traversal order);
 
 // Getting minimum node
 RBNode *getMinNode(RBNode *root);
+RBNode *getMaxNode(RBNode *root);
+
+// In-order neighbours
+RBNode *nextNode(RBNode *node);
+RBNode *prevNode(RBNode *node);
 
 #endif // RB_TREE
\ No newline at end of file
@@ -32,6 +32,10 @@ enum ins_opcode_t
 	READ,  // Write data to a byte on memory
 	WRITE, // Read data from a byte on memory
 	SYSCALL,
+	MEMSET, // Fill a range of memory with a byte
+	MEMCPY, // Copy a range of memory
+	READW,  // Read a 16/32/64-bit value, width in bytes in arg_3
+	WRITEW, // Write a 16/32/64-bit value, high half in arg_4
 };
 
 /* instructions executed by the CPU */
@@ -42,6 +46,7 @@ struct inst_t
 	uint32_t arg_1;
 	uint32_t arg_2;
 	uint32_t arg_3;
+	uint32_t arg_4;
 };
 
 struct code_seg_t
@@ -73,6 +78,22 @@ struct page_table_t
 	int size; // Number of row in the first layer
 };
 
+/* Resource usage of a process, read with the getrusage system call */
+struct rusage_struct
+{
+	uint32_t ru_rss;	// Resident pages
+	uint32_t ru_nswap;	// Swapped out pages
+	uint32_t ru_minflt;	// Page faults served without reading swap
+	uint32_t ru_majflt;	// Page faults that read swap
+	uint32_t ru_inblock;	// Bytes swapped in
+	uint32_t ru_oublock;	// Bytes swapped out
+	uint32_t ru_utime;	// Time slots spent on a CPU
+	uint32_t ru_nvcsw;	// Voluntary context switches
+	uint32_t ru_nivcsw;	// Involuntary context switches
+	uint32_t ru_prio;	// Current priority, niceness under CFS
+	uint32_t ru_vruntime;	// Current virtual runtime under CFS
+};
+
 /* PCB, describe information about a process */
 struct pcb_t
 {
@@ -91,6 +112,7 @@ struct pcb_t
 	uint32_t cpu_burst_time;  
 	uint32_t waiting_time;    
 	uint32_t turnaround_time; 
+	struct rusage_struct ru; // Resource usage counters
 
 #ifdef MLQ_SCHED
 	struct queue_t *mlq_ready_queue;
@@ -111,6 +133,8 @@ struct pcb_t
 	struct memphy_struct **mswp;
 	struct memphy_struct *active_mswp;
 	uint32_t active_mswp_id;
+	unsigned long mem_ticks;	 // Device time not paid in slots yet
+	uint32_t mem_stall;		 // Slots spent waiting on memory devices
 #endif
 	struct page_table_t *page_table; // Page table
 	uint32_t bp;			 // Break pointer
@@ -6,7 +6,8 @@
 
 /* Execute an instruction of a process. Return 0
  * if the instruction is executed successfully.
- * Otherwise, return 1. */
+ * Otherwise, return 1. A slot owed to the memory
+ * stall of earlier instructions executes nothing. */
 int run(struct pcb_t * proc);
 
 #endif
@@ -15,12 +15,23 @@
 #define SYSMEM_SWP_OP 3
 #define SYSMEM_IO_READ 4
 #define SYSMEM_IO_WRITE 5
+#define SYSMEM_IO_READW 6
+#define SYSMEM_IO_WRITEW 7
+#define SYSMEM_IO_READP 8  /* whole frame a2 to the buffer of the entry */
+#define SYSMEM_IO_WRITEP 9
+#define SYSMEM_IO_SUBMIT 10 /* run the memmap ring, a2 returns the count */
+#define SYSMEM_SWPOUT_OP 11 /* frame a2 to frame a3 of swap type a4 */
+#define SYSMEM_SWPIN_OP 12  /* frame a3 of swap type a4 to frame a2 */
 
 extern struct vm_area_struct *get_vma_by_num(struct mm_struct *mm, int vmaid);
 int inc_vma_limit(struct pcb_t*, int, int);
 int __mm_swap_page(struct pcb_t*, int, int);
-int liballoc(struct pcb_t *, uint32_t, uint32_t);
+int liballoc(struct pcb_t *, uint32_t, uint32_t, uint32_t);
 int libfree(struct pcb_t *, uint32_t);
 int libread(struct pcb_t*, uint32_t, uint32_t, uint32_t*);
 int libwrite(struct pcb_t*, BYTE, uint32_t, uint32_t);
+int libreadw(struct pcb_t*, uint32_t, uint32_t, uint32_t, uint64_t*);
+int libwritew(struct pcb_t*, uint64_t, uint32_t, uint32_t, uint32_t);
+int libmemset(struct pcb_t*, BYTE, uint32_t, uint32_t, uint32_t);
+int libmemcpy(struct pcb_t*, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
 int free_pcb_memph(struct pcb_t *proc);
@@ -4,6 +4,7 @@
 #include "common.h"
 
 struct pcb_t * load(const char * path);
+uint32_t alloc_pid(void);
 
 #endif
 
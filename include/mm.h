@@ -21,6 +21,36 @@
 #define PAGING_PTE_DIRTY_MASK BIT(28)
 #define PAGING_PTE_EMPTY01_MASK BIT(14)
 #define PAGING_PTE_EMPTY02_MASK BIT(13)
+#define PAGING_PTE_READAHEAD_MASK PAGING_PTE_EMPTY01_MASK /* present, read ahead, not touched yet */
+#define PAGING_PTE_COW_MASK PAGING_PTE_EMPTY02_MASK /* present, frame shared, copied on write */
+#define PAGING_PTE_HUGE_MASK BIT(27) /* present, part of a huge page */
+
+/* Swap readahead window, in pages */
+#define SWAP_RA_MIN 2
+#define SWAP_RA_MAX 8
+
+/* Shared memory segments */
+#define SHM_MAX_SEG 16
+
+/* Huge pages, an aligned run of HPAGE_NR pages on one block of frames */
+#define HPAGE_ORDER 4
+#define HPAGE_NR (1 << HPAGE_ORDER)
+/* Pages a FIFO entry stands for, a huge page has a single entry */
+#define HPAGE_WEIGHT(pte) (((pte) & PAGING_PTE_HUGE_MASK) ? HPAGE_NR : 1)
+
+/* Pages the reclaimer takes from one address space before moving on,
+ * and the rounds of direct reclaim before an allocation fails */
+#define RECLAIM_BATCH 4
+#define RECLAIM_RETRY 64
+
+/* Time slots of a load control window when none is given */
+#define PFF_WINDOW 4
+
+/* Device latencies are given in ticks, a time slot lasts this many */
+#define MEMPHY_SLOT_TICKS 1000
+
+/* Areas other than the heap are mapped from the middle of the space up */
+#define VM_MMAP_BASE (PAGING_MAX_PGN * PAGING_PAGESZ / 2)
 
 /* PTE BIT PRESENT */
 #define PAGING_PTE_SET_PRESENT(pte) (pte=pte|PAGING_PTE_PRESENT_MASK)
@@ -50,6 +80,9 @@
 #define PAGING_PTE_PGN(pte)   GETVAL(pte,PAGING_PGN_MASK,PAGING_ADDR_PGN_LOBIT)
 #define PAGING_PTE_FPN(pte)   GETVAL(pte,PAGING_PTE_FPN_MASK,PAGING_PTE_FPN_LOBIT)
 #define PAGING_PTE_SWP(pte)   GETVAL(pte,PAGING_PTE_SWPOFF_MASK,PAGING_SWPFPN_OFFSET)
+#define PAGING_PTE_SWPTYP(pte) GETVAL(pte,PAGING_PTE_SWPTYP_MASK,PAGING_PTE_SWPTYP_LOBIT)
+#define PAGING_MAX_SWPOFF     (PAGING_PTE_SWPOFF_MASK >> PAGING_PTE_SWPOFF_LOBIT)
+#define PAGING_ZSWAP_SWPTYP   PAGING_MAX_MMSWP /* swap type of pages held by zswap */
 
 /* OFFSET */
 #define PAGING_ADDR_OFFST_LOBIT 0
@@ -93,6 +126,10 @@
 /* Extract SWAPTYPE */
 #define PAGING_FPN(x)  GETVAL(x,PAGING_PTE_FPN_MASK,PAGING_PTE_FPN_LOBIT)
 
+/* Frame flags */
+#define FRAME_FREE BIT(0) /* head of a free buddy block */
+#define FRAME_SWAPCACHE BIT(1) /* swp_typ/swp_off still match the content */
+
 /* Memory range operator */
 /* TODO implement the INCLUDE and OVERLAP checking mechanism */
 #define INCLUDE(x1,x2,y1,y2) (0)
@@ -101,7 +138,11 @@
 /* VM region prototypes */
 struct vm_rg_struct * init_vm_rg(int rg_start, int rg_endi);
 int enlist_vm_rg_node(struct vm_rg_struct **rglist, struct vm_rg_struct* rgnode);
-int enlist_pgn_node(struct pgn_t **pgnlist, int pgn);
+int enlist_pgn_node(struct mm_struct *mm, int pgn);
+int delist_pgn_node(struct mm_struct *mm, int pgn);
+int enlist_rmap_node(struct rmap_struct **rmlist, struct mm_struct *mm, int pgn);
+int delist_rmap_node(struct rmap_struct **rmlist, struct mm_struct *mm, int pgn);
+void free_rmap_list(struct rmap_struct **rmlist);
 int vmap_page_range(struct pcb_t *caller, int addr, int pgnum, 
                     struct framephy_struct *frames, struct vm_rg_struct *ret_rg);
 int vm_map_ram(struct pcb_t *caller, int astart, int send, int mapstart, int incpgnum, struct vm_rg_struct *ret_rg);
@@ -110,6 +151,8 @@ int __swap_cp_page(struct memphy_struct *mpsrc, int srcfpn,
                 struct memphy_struct *mpdst, int dstfpn) ;
 int pte_set_fpn(uint32_t *pte, int fpn);
 int pte_set_swap(uint32_t *pte, int swptyp, int swpoff);
+int pte_set_reserve(uint32_t *pte);
+int vmap_reserve_range(struct pcb_t *caller, int addr, int pgnum);
 int init_pte(uint32_t *pte,
              int pre,    // present
              int fpn,    // FPN
@@ -119,8 +162,24 @@ int init_pte(uint32_t *pte,
              int swpoff); //swap offset
 int __alloc(struct pcb_t *caller, int vmaid, int rgid, int size, int *alloc_addr);
 int __free(struct pcb_t *caller, int vmaid, int rgid);
+int __populate(struct pcb_t *caller, int vmaid, int rgid);
+int __dup_mm(struct pcb_t *caller, struct pcb_t *child);
+void free_pbc_mem(struct pcb_t *proc);
+int __shmget(struct pcb_t *caller, int key, int size);
+int __shmat(struct pcb_t *caller, int key, int rgid);
+void hpage_enable(int on);
+void mm_list_add(struct mm_struct *mm, struct pcb_t *owner);
+int mm_reclaim(struct pcb_t *caller, int nr);
+int oom_kill(struct pcb_t *caller);
+int oom_killed(struct pcb_t *proc);
+struct pcb_t *mm_select_holdback(void);
+int __getrusage(struct pcb_t *caller, struct rusage_struct *ru);
 int __read(struct pcb_t *caller, int vmaid, int rgid, int offset, BYTE *data);
 int __write(struct pcb_t *caller, int vmaid, int rgid, int offset, BYTE value);
+int __read_word(struct pcb_t *caller, int vmaid, int rgid, int offset, int width, uint64_t *data);
+int __write_word(struct pcb_t *caller, int vmaid, int rgid, int offset, int width, uint64_t value);
+int __memset(struct pcb_t *caller, int vmaid, int rgid, int offset, BYTE value, int size);
+int __memcpy(struct pcb_t *caller, int vmaid, int dstrg, int dstoff, int srcrg, int srcoff, int size);
 int init_mm(struct mm_struct *mm, struct pcb_t *caller);
 
 /* VM prototypes */
@@ -143,14 +202,68 @@ int get_free_vmrg_area(struct pcb_t *caller, int vmaid, int size, struct vm_rg_s
 int inc_vma_limit(struct pcb_t *caller, int vmaid, int inc_sz);
 int find_victim_page(struct mm_struct* mm, int *pgn);
 struct vm_area_struct *get_vma_by_num(struct mm_struct *mm, int vmaid);
+struct vm_area_struct *find_vma(struct mm_struct *mm, unsigned long addr);
+unsigned long get_unmapped_area(struct mm_struct *mm, unsigned long low, unsigned long size);
+int vma_link(struct mm_struct *mm, struct vm_area_struct *vma);
+void vma_unlink(struct mm_struct *mm, struct vm_area_struct *vma);
+void vma_update_gap(struct mm_struct *mm, struct vm_area_struct *vma);
+struct vm_area_struct *vm_map_area(struct pcb_t *caller, int size);
+
+/* Swap device prototypes */
+struct memphy_struct *swap_device(struct pcb_t *caller, int swptyp);
+int swap_get_freefp(struct pcb_t *caller, int *swptyp, int *swpfpn);
+int swap_put_freefp(struct pcb_t *caller, int swptyp, int swpfpn);
+int swap_cache_add(struct pcb_t *caller, int fpn, int swptyp, int swpfpn);
+int swap_cache_take(struct pcb_t *caller, int fpn, int *swptyp, int *swpfpn);
+int swap_cache_drop(struct pcb_t *caller, int fpn);
+int swap_dup(struct pcb_t *caller, struct mm_struct *mm, int pgn, int *swptyp, int *swpfpn);
+
+/* Compressed swap pool prototypes */
+int zswap_init(int pool_sz);
+int zswap_enabled(void);
+int zswap_store(struct pcb_t *caller, struct mm_struct *mm, int pgn, int fpn,
+                int *swptyp, int *swpoff);
+int zswap_load(struct pcb_t *caller, int swpoff, int fpn);
+int zswap_invalidate(int swpoff);
+int zswap_dup(struct pcb_t *caller, struct mm_struct *mm, int pgn,
+              int *swptyp, int *swpoff);
+void zswap_miss(void);
+int zswap_stats(void);
+
+/* Page reclaim prototypes */
+int kswapd_init(struct memphy_struct *mram, int low, int high);
+void kswapd_exit(void);
+void kswapd_wakeup(struct memphy_struct *mram);
+int try_to_free_pages(struct pcb_t *caller);
+int out_of_memory(struct pcb_t *caller);
+
+/* Load control prototypes */
+int pff_init(int threshold, int window);
+void pff_fault(struct pcb_t *caller);
+struct pcb_t *pff_held(void);
+void pff_exit(struct pcb_t *proc);
+int pff_stats(void);
+int reclaim_stats(void);
 
 /* MEM/PHY protypes */
 int MEMPHY_get_freefp(struct memphy_struct *mp, int *fpn);
 int MEMPHY_put_freefp(struct memphy_struct *mp, int fpn);
+int MEMPHY_get_freefp_order(struct memphy_struct *mp, int order, int *fpn);
+int MEMPHY_put_freefp_order(struct memphy_struct *mp, int fpn, int order);
+int MEMPHY_frag_index(struct memphy_struct *mp, int order);
+int MEMPHY_buddyinfo(struct memphy_struct *mp);
 int MEMPHY_read(struct memphy_struct * mp, int addr, BYTE *value);
 int MEMPHY_write(struct memphy_struct * mp, int addr, BYTE data);
+int MEMPHY_read_word(struct memphy_struct *mp, int addr, int len, uint64_t *value);
+int MEMPHY_write_word(struct memphy_struct *mp, int addr, int len, uint64_t value);
+int MEMPHY_read_page(struct memphy_struct *mp, int fpn, BYTE *buf);
+int MEMPHY_write_page(struct memphy_struct *mp, int fpn, const BYTE *buf);
 int MEMPHY_dump(struct memphy_struct * mp);
+int MEMPHY_set_latency(struct memphy_struct *mp, int access, int page, int seek);
+unsigned long MEMPHY_take_ticks(void);
 int init_memphy(struct memphy_struct *mp, int max_size, int randomflg);
+int init_memphy_mmap(struct memphy_struct *mp, int max_size, int randomflg,
+                     const char *path, int persist);
 
 /* print list */
 int print_list_fp(struct framephy_struct *fp);
@@ -11,5 +11,8 @@
 //#define MMDBG 1
 #define IODUMP 1
 #define PAGETBL_DUMP 1
+#define MM_SWAP_MMAP
+//#define MM_SWAP_FILE "swap%d.img"
+//#define MM_SWAP_PERSIST 1
 
 #endif
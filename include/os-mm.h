@@ -1,10 +1,16 @@
 #ifndef OSMM_H
 #define OSMM_H
 
+#include <sys/types.h> /* pthread_mutex_t, pthread.h would pull in our sched.h */
 
 #define MM_PAGING
 #define PAGING_MAX_MMSWP 4 /* max number of supported swapped space */
 #define PAGING_MAX_SYMTBL_SZ 30
+#define MEMPHY_MAX_ORDER 11 /* buddy blocks span 2^0 .. 2^10 frames */
+#define VM_RG_NR_CLASS 32 /* free region size classes, one per power of two */
+#define VM_RG_TAG_BUCKETS 61 /* boundary tag hash buckets */
+
+struct RBNode;
 
 typedef char BYTE;
 typedef uint32_t addr_t;
@@ -23,6 +29,25 @@ struct vm_rg_struct {
    unsigned long rg_end;
 
    struct vm_rg_struct *rg_next;
+
+   /* Free region index links */
+   struct vm_rg_struct *rg_prev;  /* vm_freerg_list */
+   struct vm_rg_struct *rg_cnext; /* size class list */
+   struct vm_rg_struct *rg_cprev;
+   struct vm_rg_struct *rg_snext; /* boundary tag chain of rg_start */
+   struct vm_rg_struct *rg_enext; /* boundary tag chain of rg_end */
+};
+
+/*
+ *  Segregated fit index of the free regions of an area. A bitmap tells
+ *  which size classes are not empty, the boundary tags find the free
+ *  neighbours of a region by address.
+ */
+struct vm_rg_index {
+   uint32_t class_map;
+   struct vm_rg_struct *class_head[VM_RG_NR_CLASS];
+   struct vm_rg_struct *tag_start[VM_RG_TAG_BUCKETS];
+   struct vm_rg_struct *tag_end[VM_RG_TAG_BUCKETS];
 };
 
 /*
@@ -40,22 +65,78 @@ struct vm_area_struct {
  */
    struct mm_struct *vm_mm;
    struct vm_rg_struct *vm_freerg_list;
-   struct vm_area_struct *vm_next;
+   struct vm_rg_index vm_freerg_idx;
+   struct vm_area_struct *vm_next; /* sorted by vm_start */
+
+   /* Area tree, keyed by vm_start */
+   struct RBNode *vm_rb;
+   unsigned long vm_gap;         /* free space below vm_start */
+   unsigned long vm_subtree_gap; /* largest vm_gap in the subtree */
+};
+
+/*
+ * Submission and completion ring of memmap operations, the queued
+ * operations are run in order by a single sys_memmap call
+ */
+#define MEMMAP_RING_SZ 16
+
+struct memmap_sqe {
+   uint32_t op;             /* SYSMEM_* operation */
+   uint32_t a2, a3, a4, a5; /* its registers, as for a single call */
+   BYTE *buf;               /* page of SYSMEM_IO_READP and SYSMEM_IO_WRITEP */
+   uint64_t *res;           /* where the value read goes, may be NULL */
+};
+
+struct memmap_cqe {
+   int ret;
+   uint64_t val;            /* value read, a5 above a3 */
+   uint64_t *res;
+};
+
+struct memmap_ring {
+   struct memmap_sqe sq[MEMMAP_RING_SZ];
+   struct memmap_cqe cq[MEMMAP_RING_SZ];
+   unsigned int sq_head, sq_tail; /* the kernel consumes at the head */
+   unsigned int cq_head, cq_tail; /* the process reaps at the head */
 };
 
 /* 
  * Memory management struct
  */
 struct mm_struct {
+   /* Address space lock, see the lock order in libmem.c */
+   pthread_mutex_t mm_lock;
+
    uint32_t *pgd;
 
    struct vm_area_struct *mmap;
+   struct RBNode *mm_rb; /* same areas, augmented with the gaps */
 
    /* Currently we support a fixed number of symbol */
    struct vm_rg_struct symrgtbl[PAGING_MAX_SYMTBL_SZ];
 
    /* list of free page */
    struct pgn_t *fifo_pgn;
+   int nr_resident; /* pages on fifo_pgn, see HPAGE_WEIGHT */
+
+   /* Swap readahead */
+   int ra_win;           /* pages read ahead on the next sequential fault */
+   int ra_prev_pgn;      /* last page faulted in */
+   int ra_next_pgn;      /* first page after the last window */
+   unsigned long ra_hit; /* read ahead pages used */
+   unsigned long ra_miss;/* read ahead pages evicted unused */
+
+   /* Huge pages */
+   unsigned long hp_fault; /* huge pages mapped on first touch */
+   unsigned long hp_split; /* huge pages split back into base pages */
+
+   /* Reclaim list of all process address spaces */
+   struct pcb_t *owner;
+   struct mm_struct *mm_next;
+   int oom_killed; /* picked by the OOM killer, under mm_lock */
+
+   /* Batched memmap operations, empty whenever mm_lock is free */
+   struct memmap_ring io_ring;
 };
 
 /*
@@ -69,6 +150,46 @@ struct framephy_struct {
    struct mm_struct* owner; // tracks which process owns this frame
 };
 
+/*
+ * Reverse map entry, one page table mapping a shared frame
+ */
+struct rmap_struct {
+   struct mm_struct *mm;
+   int pgn;
+   struct rmap_struct *rm_next;
+};
+
+/*
+ * Shared memory segment, its own page table is one more mapping of its
+ * pages so they outlive the processes attached to it
+ */
+struct shm_attach {
+   struct mm_struct *mm;
+   int pgn; /* first page of the attachment */
+   struct shm_attach *at_next;
+};
+
+struct shm_struct {
+   int key;
+   int npages;
+   struct mm_struct *mm;
+   struct shm_attach *attach;
+};
+
+/*
+ * Per-frame bookkeeping of a MEMPHY device, indexed by FPN
+ */
+struct frame_struct {
+   int flags;
+   int order;   /* order of the free buddy block headed by this frame */
+   int bd_next; /* free area list links (FPN), -1 terminated */
+   int bd_prev;
+   int swp_typ; /* swap cache, slot holding a clean copy of the frame */
+   int swp_off;
+   int mapcount; /* other page tables (or PTEs) sharing the frame */
+   struct rmap_struct *rmap; /* all mappings, kept only while shared */
+};
+
 struct memphy_struct {
    /* Basic field of data and size */
    BYTE *storage;
@@ -79,8 +200,29 @@ struct memphy_struct {
    int cursor;
 
    /* Management structure */
-   struct framephy_struct *free_fp_list;
    struct framephy_struct *used_fp_list;
+
+   /* Frame allocator and sequential cursor lock, innermost of all */
+   pthread_mutex_t lock;
+
+   /* Buddy allocator */
+   int maxfp;
+   struct frame_struct *frames;
+   int free_area[MEMPHY_MAX_ORDER]; /* head FPN of free blocks per order */
+   int nr_free[MEMPHY_MAX_ORDER];   /* number of free blocks per order */
+   int free_fpnum;
+   int lazy_fpn;                    /* frames from here up were never used */
+   unsigned long nr_alloc;          /* successful block allocations */
+   int zero_fpn;                    /* shared zero frame, -1 until first read */
+   unsigned long *used_map;         /* allocated frames, BIT_WORD/BIT_MASK */
+
+   /* Swap device fields */
+   int swp_prio;                    /* higher is used first */
+
+   /* Cost model, in MEMPHY_SLOT_TICKS per time slot */
+   int lat_access;                  /* every access */
+   int lat_page;                    /* transfer of a whole frame */
+   int lat_seek;                    /* per page the cursor travels */
 };
 
 #endif
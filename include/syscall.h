@@ -31,10 +31,15 @@ struct sc_regs {
 
 
 /* This is used purely for kernel trace the table of system call */
-//typedef long (*sys_call_ptr_t)(const struct sc_regs *);
+typedef int (*sys_call_ptr_t)(struct pcb_t *, struct sc_regs *);
 extern const char* sys_call_table[];
+extern const sys_call_ptr_t sys_call_handlers[];
 extern const int syscall_table_size;
+extern int sys_call_stat_on;
 int syscall(struct pcb_t*, uint32_t, struct sc_regs*);
 int libsyscall(struct pcb_t*, uint32_t, uint32_t, uint32_t, uint32_t);
 int __sys_ni_syscall(struct pcb_t*, struct sc_regs*);
+void syscall_stat_enable(int on, int timed);
+void syscall_stat_ops(uint32_t nr, unsigned long ops);
+int syscall_stats(void);
 
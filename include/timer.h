@@ -25,4 +25,8 @@ void next_slot(struct timer_id_t* timer_id);
 
 uint64_t current_time();
 
+/* Run @hook in the timer thread between two slots, while every device
+ * waits for the next one. Set it before the devices start. */
+void set_slot_hook(void (*hook)(void));
+
 #endif
@@ -51,6 +51,9 @@ enable_cfs() {
 //#define MMDBG 1
 #define IODUMP 1
 #define PAGETBL_DUMP 1
+#define MM_SWAP_MMAP
+//#define MM_SWAP_FILE "swap%d.img"
+//#define MM_SWAP_PERSIST 1
 
 #endif
 EOF
@@ -119,6 +122,9 @@ enable_mlq() {
 //#define MMDBG 1
 #define IODUMP 1
 #define PAGETBL_DUMP 1
+#define MM_SWAP_MMAP
+//#define MM_SWAP_FILE "swap%d.img"
+//#define MM_SWAP_PERSIST 1
 
 #endif
 EOF
@@ -24,6 +24,8 @@ Dtype *createDtype(struct pcb_t *proc, int timestamp) {
     }
     data->proc = proc;
     data->timestamp = timestamp;
+    data->item = NULL;
+    data->augment = NULL;
 #ifdef CFS_SCHED
     data->key = proc->vruntime;
 #else
@@ -32,6 +34,14 @@ Dtype *createDtype(struct pcb_t *proc, int timestamp) {
     return data;
 }
 
+// Augmented trees keep a value per subtree, refresh it from node to root
+void augmentPath(RBNode *node) {
+    for (; node != NULL; node = node->parent) {
+        if (node->data->augment)
+            node->data->augment(node);
+    }
+}
+
 // Rotation operations
 RBNode *rotateLeft(RBNode *root, RBNode *x) {
     RBNode *y = x->right;
@@ -53,6 +63,12 @@ RBNode *rotateLeft(RBNode *root, RBNode *x) {
 
     y->left = x;
     x->parent = y;
+
+    // x is below y now, its subtree changed first
+    if (x->data->augment) {
+        x->data->augment(x);
+        y->data->augment(y);
+    }
     return root;
 }
 
@@ -76,6 +92,11 @@ RBNode *rotateRight(RBNode *root, RBNode *y) {
 
     x->right = y;
     y->parent = x;
+
+    if (y->data->augment) {
+        y->data->augment(y);
+        x->data->augment(x);
+    }
     return root;
 }
 
@@ -142,6 +163,7 @@ void insertNode(RBNode **root, Dtype *data) {
     if (*root == NULL) {
         *root = new_node;
         (*root)->color = BLACK;
+        augmentPath(new_node);
         return;
     }
 
@@ -161,6 +183,7 @@ void insertNode(RBNode **root, Dtype *data) {
     else 
         new_node->parent->right = new_node;
 
+    augmentPath(new_node);
     insertFixup(root, new_node);
 }
 
@@ -277,6 +300,9 @@ void deleteNode(RBNode **root, Dtype *data) {
         free(del_node);
     }
     
+    // Subtrees on the path from the removed position lost a node
+    augmentPath(x_parent);
+
     // Fix RB tree properties if needed
     if (y_original_color == BLACK) {
         deleteFixup(root, x, x_parent);
@@ -409,4 +435,31 @@ RBNode *getMinNode(RBNode *root) {
         root = root->left;
     }
     return root;
-}
\ No newline at end of file
+}
+RBNode *getMaxNode(RBNode *root) {
+    if (root == NULL) return NULL;
+    while (root->right != NULL) {
+        root = root->right;
+    }
+    return root;
+}
+
+
+// In-order successor and predecessor
+RBNode *nextNode(RBNode *node) {
+    if (node == NULL) return NULL;
+    if (node->right != NULL)
+        return getMinNode(node->right);
+    while (node->parent != NULL && node == node->parent->right)
+        node = node->parent;
+    return node->parent;
+}
+
+RBNode *prevNode(RBNode *node) {
+    if (node == NULL) return NULL;
+    if (node->left != NULL)
+        return getMaxNode(node->left);
+    while (node->parent != NULL && node == node->parent->left)
+        node = node->parent;
+    return node->parent;
+}
@@ -58,8 +58,101 @@ int write(
 	return write_mem(proc->regs[destination] + offset, proc, data);
 }
 
+int fill(
+	struct pcb_t *proc,	// Process executing the instruction
+	BYTE data,		// Fill byte
+	uint32_t destination,	// Index of destination register
+	uint32_t offset,	// Destination address = [destination] + [offset]
+	uint32_t size)
+{
+	uint32_t i;
+
+	for (i = 0; i < size; i++)
+		if (write_mem(proc->regs[destination] + offset + i, proc, data))
+			return 1;
+	return 0;
+}
+
+int copy(
+	struct pcb_t *proc,	// Process executing the instruction
+	uint32_t destination,	// Index of destination register
+	uint32_t dstoff,	// Destination address = [destination] + [dstoff]
+	uint32_t source,	// Index of source register
+	uint32_t srcoff,	// Source address = [source] + [srcoff]
+	uint32_t size)
+{
+	addr_t dst = proc->regs[destination] + dstoff;
+	addr_t src = proc->regs[source] + srcoff;
+	uint32_t i, at;
+	BYTE data;
+
+	/* Overlapping ranges copy from the end when moving up */
+	for (i = 0; i < size; i++) {
+		at = (dst > src && dst < src + size) ? size - 1 - i : i;
+		if (read_mem(src + at, proc, &data) ||
+		    write_mem(dst + at, proc, data))
+			return 1;
+	}
+	return 0;
+}
+
+int readw(
+	struct pcb_t *proc,	// Process executing the instruction
+	uint32_t source,	// Index of source register
+	uint32_t offset,	// Source address = [source] + [offset]
+	uint32_t destination,	// Index of destination register
+	uint32_t width)		// Value size in bytes
+{
+	uint32_t i, value = 0;
+	BYTE data;
+
+	/* Little endian, the register keeps the low 32 bits */
+	for (i = 0; i < width; i++) {
+		if (read_mem(proc->regs[source] + offset + i, proc, &data))
+			return 1;
+		if (i < 4)
+			value |= (uint32_t)(unsigned char)data << (8 * i);
+	}
+	proc->regs[destination] = value;
+	return 0;
+}
+
+int writew(
+	struct pcb_t *proc,	// Process executing the instruction
+	uint64_t data,		// Data to be wrttien into memory
+	uint32_t destination,	// Index of destination register
+	uint32_t offset,	// Destination address = [destination] + [offset]
+	uint32_t width)		// Value size in bytes
+{
+	uint32_t i;
+
+	for (i = 0; i < width; i++)
+		if (write_mem(proc->regs[destination] + offset + i, proc, (BYTE)(data >> (8 * i))))
+			return 1;
+	return 0;
+}
+
 int run(struct pcb_t *proc)
 {
+	proc->ru.ru_utime++;
+#ifdef MM_PAGING
+	/* Killed to make room in memory, it ends without its stall */
+	if (oom_killed(proc))
+	{
+		proc->pc = proc->code->size;
+		proc->mem_ticks = 0;
+		return 1;
+	}
+	/* The slot goes to the memory stall left by earlier instructions */
+	if (proc->mem_ticks >= MEMPHY_SLOT_TICKS)
+	{
+		proc->mem_ticks -= MEMPHY_SLOT_TICKS;
+		proc->mem_stall++;
+		return 0;
+	}
+	MEMPHY_take_ticks();
+#endif
+
 	/* Check if Program Counter point to the proper instruction */
 	if (proc->pc >= proc->code->size)
 	{
@@ -69,6 +162,7 @@ int run(struct pcb_t *proc)
 	struct inst_t ins = proc->code->text[proc->pc];
 	proc->pc++;
 	int stat = 1;
+	uint64_t word;
 switch (ins.opcode)
 	{
 	case CALC:
@@ -76,7 +170,7 @@ switch (ins.opcode)
 		break;
 	case ALLOC:
 #ifdef MM_PAGING
-		stat = liballoc(proc, ins.arg_0, ins.arg_1);
+		stat = liballoc(proc, ins.arg_0, ins.arg_1, ins.arg_2);
 #else
 		stat = alloc(proc, ins.arg_0, ins.arg_1);
 #endif
@@ -105,8 +199,40 @@ switch (ins.opcode)
 	case SYSCALL:
 		stat = libsyscall(proc, ins.arg_0, ins.arg_1, ins.arg_2, ins.arg_3);
 		break;
+	case MEMSET:
+#ifdef MM_PAGING
+		stat = libmemset(proc, ins.arg_0, ins.arg_1, ins.arg_2, ins.arg_3);
+#else
+		stat = fill(proc, ins.arg_0, ins.arg_1, ins.arg_2, ins.arg_3);
+#endif
+		break;
+	case MEMCPY:
+#ifdef MM_PAGING
+		stat = libmemcpy(proc, ins.arg_0, ins.arg_1, ins.arg_2, ins.arg_3, ins.arg_4);
+#else
+		stat = copy(proc, ins.arg_0, ins.arg_1, ins.arg_2, ins.arg_3, ins.arg_4);
+#endif
+		break;
+	case READW:
+#ifdef MM_PAGING
+		stat = libreadw(proc, ins.arg_0, ins.arg_1, ins.arg_3, &word);
+#else
+		stat = readw(proc, ins.arg_0, ins.arg_1, ins.arg_2, ins.arg_3);
+#endif
+		break;
+	case WRITEW:
+		word = ((uint64_t)ins.arg_4 << 32) | ins.arg_0;
+#ifdef MM_PAGING
+		stat = libwritew(proc, word, ins.arg_1, ins.arg_2, ins.arg_3);
+#else
+		stat = writew(proc, word, ins.arg_1, ins.arg_2, ins.arg_3);
+#endif
+		break;
 	default:
 		stat = 1;
 	}
+#ifdef MM_PAGING
+	proc->mem_ticks += MEMPHY_take_ticks();
+#endif
 	return stat;
 }
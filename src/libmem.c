@@ -18,11 +18,260 @@
  #include "mm.h"
  #include "syscall.h"
  #include "libmem.h"
+ #include "RBTree.h"
  #include <stdlib.h>
  #include <stdio.h>
  #include <pthread.h>
+ #include <time.h>
+ 
+ /*
+  * Locking, outermost first:
+  *   mm->mm_lock      address space of a process: areas, free regions,
+  *                    symbol table, page table, FIFO list, readahead
+  *   mmlist_lock      reclaim list of address spaces
+  *   segment mm_lock  page table of a shared memory segment
+  *   shm_lock         segment table and attachment lists
+  *   rmap_lock        mapcount and reverse map of shared frames, zero frame
+  *   zswap_lock       compressed pool (mm-zswap.c)
+  *   swap_lock        swap device choice (mm-swap.c)
+  *   memphy lock      frame allocator of one device, swap slot references
+  *
+  * Evicting a shared frame updates the PTEs of all its mappings, zswap
+  * writeback the PTE of the page owner. Those address spaces are only
+  * tried, never waited for, so the order above is never inverted and a
+  * victim whose mappings are busy is skipped. With all of them locked the
+  * reverse map cannot change, rmap_lock is not held during the copy.
+  * Reclaiming from other processes tries their address spaces the same
+  * way, with mmlist_lock held only while one is picked.
+  */
+ static pthread_mutex_t shm_lock = PTHREAD_MUTEX_INITIALIZER;
+ static pthread_mutex_t rmap_lock = PTHREAD_MUTEX_INITIALIZER;
+ static pthread_mutex_t mmlist_lock = PTHREAD_MUTEX_INITIALIZER;
+ 
+ /* Address spaces in reclaim order, the head is scanned next */
+ static struct mm_struct *mm_list;
+ static int nr_mm;
+ 
+ /* Shared memory segments, they live until the simulation ends */
+ static struct shm_struct shm_table[SHM_MAX_SEG];
+ static int nr_shm;
+ 
+ /* Map large untouched runs as huge pages, off by default */
+ static int hpage_enabled;
+ 
+ int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller);
+ static int pg_wpfault(struct mm_struct *mm, int pgn, struct pcb_t *caller);
+ static void pg_release(struct mm_struct *mm, int pgn, struct pcb_t *caller);
+ static void shm_detach_range(struct mm_struct *mm, int startpgn, int endpgn);
+ 
+ /*memmap_submit - run the memmap operations queued by the caller
+  *@caller: caller
+  *
+  * One sys_memmap call runs the whole ring, each result is then stored
+  * where its operation asked. Called with mm_lock held, the ring is empty
+  * again when this returns. When the call fails or does not complete the
+  * whole batch the batch is dropped, its completions are not reaped.
+  *
+  * A fault queues its copies too, the victim to swap and the page back
+  * in, so they go in the same call as the access that faulted. Code that
+  * reaches a frame other than through the ring, or lets another address
+  * space at it, submits first.
+  */
+ static int memmap_submit(struct pcb_t *caller)
+ {
+   struct memmap_ring *ring = &caller->mm->io_ring;
+   struct memmap_cqe *cqe;
+   struct sc_regs regs;
+   uint32_t nr = ring->sq_tail - ring->sq_head;
+   int stat = 0;
+ 
+   if (nr == 0)
+     return 0;
+ 
+   regs.a1 = SYSMEM_IO_SUBMIT;
+ 
+   /* SYSCALL 17 sys_memmap */
+   if (syscall(caller, 17, &regs) != 0 || regs.a2 != nr)
+   {
+     ring->sq_head = ring->sq_tail;
+     ring->cq_head = ring->cq_tail;
+     return -1;
+   }
+ 
+   while (ring->cq_head != ring->cq_tail)
+   {
+     cqe = &ring->cq[ring->cq_head++ % MEMMAP_RING_SZ];
+     if (cqe->ret != 0)
+       stat = -1;
+     else if (cqe->res != NULL)
+       *cqe->res = cqe->val;
+   }
+ 
+   return stat;
+ }
+ 
+ /*memmap_queue - add a memmap operation to the ring of the caller
+  *@caller: caller
+  *@op: SYSMEM_* operation
+  *@a2..a5: arguments, as for a direct sys_memmap call
+  *@buf: page buffer of SYSMEM_IO_READP/WRITEP, kept until submitted
+  *@res: where a read value goes, may be NULL
+  *
+  * A full ring is submitted first, its failure is returned.
+  */
+ static int memmap_queue(struct pcb_t *caller, uint32_t op, uint32_t a2, uint32_t a3,
+                         uint32_t a4, uint32_t a5, BYTE *buf, uint64_t *res)
+ {
+   struct memmap_ring *ring = &caller->mm->io_ring;
+   struct memmap_sqe *sqe;
+ 
+   if (ring->sq_tail - ring->sq_head == MEMMAP_RING_SZ &&
+       memmap_submit(caller) != 0)
+     return -1;
+ 
+   sqe = &ring->sq[ring->sq_tail++ % MEMMAP_RING_SZ];
+   sqe->op = op;
+   sqe->a2 = a2;
+   sqe->a3 = a3;
+   sqe->a4 = a4;
+   sqe->a5 = a5;
+   sqe->buf = buf;
+   sqe->res = res;
+ 
+   return 0;
+ }
+ 
+ /*freerg_class - size class of a free region
+  *@size: size of the region
+  *
+  */
+ static int freerg_class(unsigned long size)
+ {
+   int cls = 0;
+ 
+   while (size >>= 1)
+     cls++;
+ 
+   return cls < VM_RG_NR_CLASS ? cls : VM_RG_NR_CLASS - 1;
+ }
+ 
+ /*freerg_insert - put a region in the free list and its index
+  *@vma: area the region belongs to
+  *@rg_elmt: new region
+  *
+  */
+ static void freerg_insert(struct vm_area_struct *vma, struct vm_rg_struct *rg_elmt)
+ {
+   struct vm_rg_index *idx = &vma->vm_freerg_idx;
+   int cls = freerg_class(rg_elmt->rg_end - rg_elmt->rg_start);
+   int sb = rg_elmt->rg_start % VM_RG_TAG_BUCKETS;
+   int eb = rg_elmt->rg_end % VM_RG_TAG_BUCKETS;
+ 
+   rg_elmt->rg_prev = NULL;
+   rg_elmt->rg_next = vma->vm_freerg_list;
+   if (vma->vm_freerg_list)
+     vma->vm_freerg_list->rg_prev = rg_elmt;
+   vma->vm_freerg_list = rg_elmt;
+ 
+   rg_elmt->rg_cprev = NULL;
+   rg_elmt->rg_cnext = idx->class_head[cls];
+   if (idx->class_head[cls])
+     idx->class_head[cls]->rg_cprev = rg_elmt;
+   idx->class_head[cls] = rg_elmt;
+   idx->class_map |= BIT(cls);
+ 
+   rg_elmt->rg_snext = idx->tag_start[sb];
+   idx->tag_start[sb] = rg_elmt;
+   rg_elmt->rg_enext = idx->tag_end[eb];
+   idx->tag_end[eb] = rg_elmt;
+ }
+ 
+ /*freerg_remove - take a region out of the free list and its index
+  *@vma: area the region belongs to
+  *@rg_elmt: region in the list
+  *
+  */
+ static void freerg_remove(struct vm_area_struct *vma, struct vm_rg_struct *rg_elmt)
+ {
+   struct vm_rg_index *idx = &vma->vm_freerg_idx;
+   int cls = freerg_class(rg_elmt->rg_end - rg_elmt->rg_start);
+   struct vm_rg_struct **it;
+ 
+   if (rg_elmt->rg_prev)
+     rg_elmt->rg_prev->rg_next = rg_elmt->rg_next;
+   else
+     vma->vm_freerg_list = rg_elmt->rg_next;
+   if (rg_elmt->rg_next)
+     rg_elmt->rg_next->rg_prev = rg_elmt->rg_prev;
+ 
+   if (rg_elmt->rg_cprev)
+     rg_elmt->rg_cprev->rg_cnext = rg_elmt->rg_cnext;
+   else if ((idx->class_head[cls] = rg_elmt->rg_cnext) == NULL)
+     idx->class_map &= ~BIT(cls);
+   if (rg_elmt->rg_cnext)
+     rg_elmt->rg_cnext->rg_cprev = rg_elmt->rg_cprev;
+ 
+   /* Tag chains are short, one bucket holds few regions */
+   for (it = &idx->tag_start[rg_elmt->rg_start % VM_RG_TAG_BUCKETS]; *it != rg_elmt; it = &(*it)->rg_snext)
+     ;
+   *it = rg_elmt->rg_snext;
+   for (it = &idx->tag_end[rg_elmt->rg_end % VM_RG_TAG_BUCKETS]; *it != rg_elmt; it = &(*it)->rg_enext)
+     ;
+   *it = rg_elmt->rg_enext;
+ 
+   rg_elmt->rg_next = NULL;
+ }
+ 
+ /*freerg_find_tag - find the free region starting or ending at an address
+  *@vma: area
+  *@addr: address
+  *@end: nonzero to match the end of the region
+  *
+  */
+ static struct vm_rg_struct *freerg_find_tag(struct vm_area_struct *vma, unsigned long addr, int end)
+ {
+   struct vm_rg_struct *rg;
+ 
+   if (end)
+   {
+     for (rg = vma->vm_freerg_idx.tag_end[addr % VM_RG_TAG_BUCKETS]; rg; rg = rg->rg_enext)
+       if (rg->rg_end == addr)
+         return rg;
+   }
+   else
+   {
+     for (rg = vma->vm_freerg_idx.tag_start[addr % VM_RG_TAG_BUCKETS]; rg; rg = rg->rg_snext)
+       if (rg->rg_start == addr)
+         return rg;
+   }
+ 
+   return NULL;
+ }
+ 
+ /*freerg_find_fit - find a free region of at least size bytes
+  *@vma: area
+  *@size: needed size
+  *
+  * Every region of a class above the size's own class fits, the lowest
+  * such class is found from the bitmap. Only when none is left the
+  * size's own class is searched.
+  */
+ static struct vm_rg_struct *freerg_find_fit(struct vm_area_struct *vma, unsigned long size)
+ {
+   struct vm_rg_index *idx = &vma->vm_freerg_idx;
+   int cls = freerg_class(size);
+   uint32_t map = cls + 1 < VM_RG_NR_CLASS ? idx->class_map & ~(BIT(cls + 1) - 1) : 0;
+   struct vm_rg_struct *rg;
+ 
+   if (map)
+     return idx->class_head[__builtin_ctz(map)];
  
- static pthread_mutex_t mmvm_lock = PTHREAD_MUTEX_INITIALIZER;
+   for (rg = idx->class_head[cls]; rg; rg = rg->rg_cnext)
+     if (rg->rg_end - rg->rg_start >= size)
+       return rg;
+ 
+   return NULL;
+ }
  
  /*enlist_vm_freerg_list - add new rg to freerg_list
   *@mm: memory region
@@ -31,65 +280,28 @@
   */
  int enlist_vm_freerg_list(struct mm_struct *mm, struct vm_rg_struct *rg_elmt)
  {
-   struct vm_rg_struct *rg_node = mm->mmap->vm_freerg_list;
-   struct vm_rg_struct *rgit = mm->mmap->vm_freerg_list;  
- 
    if (rg_elmt->rg_start >= rg_elmt->rg_end)
      return -1;
  
-   while (rgit) {
-     if (rgit->rg_start <= rg_elmt->rg_start && rgit->rg_end >= rg_elmt->rg_end) {
-       return -1;
-     }
-     rgit = rgit->rg_next;
-   }
- 
-   if (rg_node != NULL)
-     rg_elmt->rg_next = rg_node;
- 
    /* Enlist the new region */
-   mm->mmap->vm_freerg_list = rg_elmt;
+   freerg_insert(mm->mmap, rg_elmt);
  
    return 0;
  }
  
  /*delist_vm_freerg_list - remove a region from vm_freerg_list
   *@mm: memory region
-  *@rg_elmt: region to be removed
+  *@rg_elmt: region to be removed, a node of the list
   *
   *Return 0 if successful, -1 otherwise
   */
  int delist_vm_freerg_list(struct mm_struct *mm, struct vm_rg_struct *rg_elmt) {
-  //printf("Get in delist\n");
    if (mm == NULL || rg_elmt == NULL || mm->mmap == NULL)
      return -1;
  
-   struct vm_rg_struct *prev = NULL;
-   struct vm_rg_struct *curr = mm->mmap->vm_freerg_list;
-   
-   if (curr == NULL)
-     return -1;
-   
-   // Delete at head
-   if (curr->rg_start == rg_elmt->rg_start && curr->rg_end == rg_elmt->rg_end) {
-     mm->mmap->vm_freerg_list = curr->rg_next;
-     //printf("Get out delist 1\n");
-     return 0;
-   }
-   
-   while (curr) {
-     prev = curr;
-     curr = curr->rg_next;
-     if (curr->rg_start == rg_elmt->rg_start && curr->rg_end == rg_elmt->rg_end) {
-       /* Found the region, remove it from the list */
-       prev->rg_next = curr->rg_next;
-       //printf("Get out delist 2\n");
-       return 0;
-     }    
-   }
-   //printf("Get out delist 3\n");
-   /* Region not found */
-   return -1;
+   freerg_remove(mm->mmap, rg_elmt);
+ 
+   return 0;
  }
  
  
@@ -121,7 +333,7 @@
    }
  
    /* Lock */
-   pthread_mutex_lock(&mmvm_lock);
+   pthread_mutex_lock(&caller->mm->mm_lock);
  
    /*Allocate at the toproof */
    struct vm_rg_struct rgnode;
@@ -135,9 +347,10 @@
  
      *alloc_addr = rgnode.rg_start;
 
-     vm_map_ram(caller, caller->mm->mmap->vm_start, caller->mm->mmap->vm_end, rgnode.rg_start, num_mapped_pages, NULL);
+     /* Free regions lie below sbrk, their pages are already reserved
+      * and get frames on first touch */
  
-     pthread_mutex_unlock(&mmvm_lock);
+     pthread_mutex_unlock(&caller->mm->mm_lock);
      return 0;
    }
  
@@ -147,7 +360,7 @@
    /*Attempt to increate limit to get space */
    struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
    if (cur_vma == NULL) {
-     pthread_mutex_unlock(&mmvm_lock);
+     pthread_mutex_unlock(&caller->mm->mm_lock);
      return -1;
    }
  
@@ -160,15 +373,11 @@
    /* TODO INCREASE THE LIMIT as inovking systemcall
     * sys_memap with SYSMEM_INC_OP
     */
-   struct sc_regs regs;
-   regs.a1 = SYSMEM_INC_OP;
-   regs.a2 = vmaid;
-   regs.a3 = inc_sz;
- 
-   /* SYSCALL 17 sys_memmap */
-   inc_limit_ret = syscall(caller, 17, &regs);
+   inc_limit_ret = memmap_queue(caller, SYSMEM_INC_OP, vmaid, inc_sz, 0, 0, NULL, NULL);
+   if (inc_limit_ret == 0)
+     inc_limit_ret = memmap_submit(caller);
    if (inc_limit_ret < 0) {
-     pthread_mutex_unlock(&mmvm_lock);
+     pthread_mutex_unlock(&caller->mm->mm_lock);
      return -1;
    }
  
@@ -191,7 +400,7 @@
    }
  
    /* Unlock */
-   pthread_mutex_unlock(&mmvm_lock);
+   pthread_mutex_unlock(&caller->mm->mm_lock);
    
    return 0;
  }
@@ -214,36 +423,58 @@
      return -1;
  
    /* Lock */
-   pthread_mutex_lock(&mmvm_lock);
+   pthread_mutex_lock(&caller->mm->mm_lock);
  
    /* Check if rgid appear in caller->mm->symrgtbl */
    if (caller->mm->symrgtbl[rgid].rg_start < 0 || caller->mm->symrgtbl[rgid].rg_end < 0) {
-     pthread_mutex_unlock(&mmvm_lock);
+     pthread_mutex_unlock(&caller->mm->mm_lock);
      return -1;
    }
  
    /* TODO: Manage the collect freed region to freerg_list */
    struct vm_rg_struct *rgnode = &(caller->mm->symrgtbl[rgid]);
    struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
-   struct vm_rg_struct *rgit = cur_vma->vm_freerg_list;
-   struct vm_rg_struct *temp_next = NULL;
+   struct vm_rg_struct *rgit;
+   int pgit;
 
-   // Merge adjacent free regions
-   while (rgit) {
-     temp_next = rgit->rg_next;
-     if (rgit->rg_end == rgnode->rg_start) {
-       rgnode->rg_start = rgit->rg_start; 
-       delist_vm_freerg_list(caller->mm, rgit); 
-       //printf("here?\n");
-       free(rgit); 
-     } else if (rgit->rg_start == rgnode->rg_end) {
-       rgnode->rg_end = rgit->rg_end; 
-       delist_vm_freerg_list(caller->mm, rgit);
-       //printf("or here?\n");
-       free(rgit);
+   /* A region mapped as its own area goes away with the area */
+   struct vm_area_struct *map_vma = find_vma(caller->mm, rgnode->rg_start);
+   if (map_vma != NULL && map_vma->vm_id != 0)
+   {
+     shm_detach_range(caller->mm, PAGING_PGN(map_vma->vm_start),
+                      PAGING_PGN(map_vma->vm_end));
+     for (pgit = PAGING_PGN(map_vma->vm_start);
+          pgit < (int)PAGING_PGN(map_vma->vm_end); pgit++)
+     {
+       pg_release(caller->mm, pgit, caller);
+       caller->mm->pgd[pgit] = 0;
      }
-     rgit = temp_next;
+     vma_unlink(caller->mm, map_vma);
+     free(map_vma);
+     rgnode->rg_start = rgnode->rg_end = -1;
+     pthread_mutex_unlock(&caller->mm->mm_lock);
+     return 0;
+   }
+
+   // Merge adjacent free regions, the boundary tags find them directly
+   if ((rgit = freerg_find_tag(cur_vma, rgnode->rg_start, 1)) != NULL) {
+     rgnode->rg_start = rgit->rg_start;
+     delist_vm_freerg_list(caller->mm, rgit);
+     free(rgit);
    }
+   if ((rgit = freerg_find_tag(cur_vma, rgnode->rg_end, 0)) != NULL) {
+     rgnode->rg_end = rgit->rg_end;
+     delist_vm_freerg_list(caller->mm, rgit);
+     free(rgit);
+   }
+ 
+   /* Pages wholly inside the region hold no live data, their frames
+    * and swap frames go back, the next touch faults in a zero page */
+   shm_detach_range(caller->mm, DIV_ROUND_UP(rgnode->rg_start, PAGING_PAGESZ),
+                    rgnode->rg_end / PAGING_PAGESZ);
+   for (pgit = DIV_ROUND_UP(rgnode->rg_start, PAGING_PAGESZ);
+        pgit < (int)(rgnode->rg_end / PAGING_PAGESZ); pgit++)
+     pg_release(caller->mm, pgit, caller);
  
    /*enlist the obsoleted memory region */
    struct vm_rg_struct *free_node = malloc(sizeof(struct vm_rg_struct));
@@ -251,22 +482,62 @@
    free_node->rg_end = rgnode->rg_end;
    rgnode->rg_start = rgnode->rg_end = -1;
    enlist_vm_freerg_list(caller->mm, free_node);
-   pthread_mutex_unlock(&mmvm_lock);  //add unlock
+   pthread_mutex_unlock(&caller->mm->mm_lock);  //add unlock
    return 0;
  }
  
+ /*__populate - fault in every page of an allocated region now
+  *@caller: caller
+  *@vmaid: ID vm area to alloc memory region
+  *@rgid: memory region ID (used to identify variable in symbole table)
+  *
+  */
+ int __populate(struct pcb_t *caller, int vmaid, int rgid)
+ {
+   struct vm_rg_struct *currg;
+   int pgit, fpn, stat;
+ 
+   if (caller == NULL || vmaid < 0 || rgid < 0 || rgid > PAGING_MAX_SYMTBL_SZ)
+     return -1;
+ 
+   /* Lock */
+   pthread_mutex_lock(&caller->mm->mm_lock);
+ 
+   currg = get_symrg_byid(caller->mm, rgid);
+   for (pgit = PAGING_PGN(currg->rg_start);
+        pgit < (int)DIV_ROUND_UP(currg->rg_end, PAGING_PAGESZ); pgit++)
+   {
+     if (pg_getpage(caller->mm, pgit, &fpn, caller) != 0 ||
+         ((caller->mm->pgd[pgit] & PAGING_PTE_COW_MASK) &&
+          pg_wpfault(caller->mm, pgit, caller) != 0))
+     {
+       memmap_submit(caller);
+       pthread_mutex_unlock(&caller->mm->mm_lock);
+       return -1;
+     }
+   }
+ 
+   /* The copies of the last fault are still queued */
+   stat = memmap_submit(caller);
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+   return stat;
+ }
+ 
  /*liballoc - PAGING-based allocate a region memory
   *@proc:  Process executing the instruction
   *@size: allocated size
   *@reg_index: memory region ID (used to identify variable in symbole table)
+  *@populate: back the region with frames now instead of on first touch
   */
- int liballoc(struct pcb_t *proc, uint32_t size, uint32_t reg_index)
+ int liballoc(struct pcb_t *proc, uint32_t size, uint32_t reg_index, uint32_t populate)
  {
    /* TODO Implement allocation on vm area 0 */
    int addr;
  
    /* By default using vmaid = 0 */
    int stat = __alloc(proc, 0, reg_index, size, &addr);
+   if (stat == 0 && populate)
+     stat = __populate(proc, 0, reg_index);
    printf("Allocated region %u with size %u, return status: %d\n",reg_index,size,stat);
    print_list_rg(proc->mm->mmap->vm_freerg_list);
    print_pgtbl(proc, 0, -1);
@@ -292,215 +563,1276 @@
    return stat;
  }
  
- /*pg_getpage - get the page in ram
+ /*shm_find_page - find the shared memory segment a page belongs to
   *@mm: memory region
   *@pagenum: PGN
-  *@framenum: return FPN
-  *@caller: caller
+  *@segpgn: return the PGN inside the segment, may be NULL
   *
   */
- int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
+ static struct shm_struct *shm_find_page(struct mm_struct *mm, int pgn, int *segpgn)
  {
-   /* Check the validation */
-   if (mm == NULL || pgn < 0 || pgn > PAGING_MAX_PGN || fpn == NULL || caller == NULL)
-     return -1;
+   struct shm_attach *at;
+   int segid;
  
-   uint32_t pte = mm->pgd[pgn];
+   pthread_mutex_lock(&shm_lock);
+   for (segid = 0; segid < nr_shm; segid++)
+   {
+     for (at = shm_table[segid].attach; at; at = at->at_next)
+     {
+       if (at->mm != mm || pgn < at->pgn || pgn >= at->pgn + shm_table[segid].npages)
+         continue;
+       if (segpgn != NULL)
+         *segpgn = pgn - at->pgn;
+       pthread_mutex_unlock(&shm_lock);
+       return &shm_table[segid];
+     }
+   }
+   pthread_mutex_unlock(&shm_lock);
+ 
+   return NULL;
+ }
  
-   if (!PAGING_PAGE_PRESENT(pte))
-   { /* Page is not online, make it actively living */
-     int vicpgn, swpfpn;
-     int vicfpn;
-     // uint32_t vicpte;
+ /* Caller holds shm_lock */
+ static void shm_attach_add(struct shm_struct *seg, struct mm_struct *mm, int pgn)
+ {
+   struct shm_attach *at = malloc(sizeof(struct shm_attach));
  
-     int tgtfpn = PAGING_PTE_SWP(pte); // the target frame storing our variable
+   at->mm = mm;
+   at->pgn = pgn;
+   at->at_next = seg->attach;
+   seg->attach = at;
+ }
  
-     /* TODO: Play with your paging theory here */
-     /* Find victim page */
-     if (find_victim_page(caller->mm, &vicpgn) == -1)
-       return -1;                          // No victim page found
-     vicfpn = PAGING_FPN(mm->pgd[vicpgn]); // we need to swap this frame out
+ /*shm_detach_range - forget the attachments inside a range of pages
+  *@mm: memory region
+  *@startpgn: first PGN
+  *@endpgn: PGN after the range
+  *
+  */
+ static void shm_detach_range(struct mm_struct *mm, int startpgn, int endpgn)
+ {
+   struct shm_attach **it;
+   int segid;
  
-     /* Get free frame in MEMSWP */
-     if (MEMPHY_get_freefp(caller->active_mswp, &swpfpn) == -1)
-       return -1; // No free frame in MEMSWP
- 
-     /* TODO: Implement swap frame from MEMRAM to MEMSWP and vice versa*/
- 
-     /* TODO copy victim frame to swap
-      * SWP(vicfpn <--> swpfpn)
-      * SYSCALL 17 sys_memmap
-      * with operation SYSMEM_SWP_OP
-      * we do this syscall to copy the content of the victim frame to the swap frame
-      */
-     struct sc_regs regs;
-     regs.a1 = SYSMEM_SWP_OP;
-     regs.a2 = vicfpn;
-     regs.a3 = swpfpn;
- 
-     /* SYSCALL 17 sys_memmap */
-     if (syscall(caller, 17, &regs) != 0)
+   pthread_mutex_lock(&shm_lock);
+   for (segid = 0; segid < nr_shm; segid++)
+   {
+     it = &shm_table[segid].attach;
+     while (*it)
      {
-       return -1; // syscall failed
+       struct shm_attach *at = *it;
+ 
+       if (at->mm == mm && at->pgn >= startpgn &&
+           at->pgn + shm_table[segid].npages <= endpgn)
+       {
+         *it = at->at_next;
+         free(at);
+         continue;
+       }
+       it = &at->at_next;
      }
+   }
+   pthread_mutex_unlock(&shm_lock);
+ }
  
-     /* TODO copy target frame from swap to mem
-      * SWP(tgtfpn <--> vicfpn)
-      * SYSCALL 17 sys_memmap
-      * with operation SYSMEM_SWP_OP
-      * we do this syscall to copy the content of the target frame to the victim frame
-      */
-     // regs.a1 = SYSMEM_SWP_OP;
-     // regs.a2 = tgtfpn;
-     // regs.a3 = vicfpn;
+ /*rmap_first - first entry of its address space in a reverse map, other
+  * than the one evicting
+  */
+ static int rmap_first(struct frame_struct *fr, struct rmap_struct *rm, struct mm_struct *mm)
+ {
+   struct rmap_struct *it;
  
-     // /* SYSCALL 17 sys_memmap */
-     // if (syscall(caller, 17, &regs) != 0) {
-     //   return -1; // syscall failed
-     // }
+   if (rm->mm == mm)
+     return 0;
+   for (it = fr->rmap; it != rm; it = it->rm_next)
+     if (it->mm == rm->mm)
+       return 0;
  
-     // Don't have any choices
-     __swap_cp_page(caller->active_mswp, tgtfpn, caller->mram, vicfpn);
+   return 1;
+ }
  
-     /* Update page table */
-     pte_set_swap(&mm->pgd[vicpgn], caller->active_mswp_id, swpfpn); // update the victim page table to swap out
+ /*rmap_unlock_to - release the other mappings of a frame up to an entry
+  *@fr: shared frame
+  *@mm: memory region of the evicting process, locked by itself
+  *@end: first entry that was not locked, NULL for all of them
+  */
+ static void rmap_unlock_to(struct frame_struct *fr, struct mm_struct *mm, struct rmap_struct *end)
+ {
+   struct rmap_struct *rm;
  
-     /* Update its online status of the target page */
-     pte_set_fpn(&mm->pgd[pgn], vicfpn);
-     // mm->pgd[pgn];
-     // pte_set_fpn();
+   for (rm = fr->rmap; rm != end; rm = rm->rm_next)
+     if (rmap_first(fr, rm, mm))
+       pthread_mutex_unlock(&rm->mm->mm_lock);
+ }
  
-     enlist_pgn_node(&caller->mm->fifo_pgn, pgn);
-   }
+ static void rmap_unlock(struct frame_struct *fr, struct mm_struct *mm)
+ {
+   rmap_unlock_to(fr, mm, NULL);
+ }
  
-   *fpn = PAGING_FPN(mm->pgd[pgn]);
+ /*rmap_trylock - lock every other address space mapping a frame
+  *@fr: shared frame, caller holds rmap_lock
+  *@mm: memory region of the evicting process, locked by itself
+  *
+  * Return -1 with nothing locked when one of them is busy.
+  */
+ static int rmap_trylock(struct frame_struct *fr, struct mm_struct *mm)
+ {
+   struct rmap_struct *rm;
+ 
+   for (rm = fr->rmap; rm; rm = rm->rm_next)
+   {
+     if (!rmap_first(fr, rm, mm))
+       continue;
+     if (pthread_mutex_trylock(&rm->mm->mm_lock) != 0)
+     {
+       rmap_unlock_to(fr, mm, rm);
+       return -1;
+     }
+   }
  
    return 0;
  }
  
- /*pg_getval - read value at given offset
+ /*pg_swapout - move the content of a resident page to swap
   *@mm: memory region
-  *@addr: virtual address to acess
-  *@data: return value
+  *@pagenum: PGN of the page
   *@caller: caller
+  *
+  * The PTE points to swap afterwards, the frame itself is not released.
+  * Return 1 when the frame is shared with an address space that is busy.
   */
- int pg_getval(struct mm_struct *mm, int addr, BYTE *data, struct pcb_t *caller)
+ static int pg_swapout(struct mm_struct *mm, int vicpgn, struct pcb_t *caller)
  {
-   int pgn = PAGING_PGN(addr);
-   int off = PAGING_OFFST(addr);
-   int fpn;
+   int vicfpn = PAGING_FPN(mm->pgd[vicpgn]);
+   struct frame_struct *fr = &caller->mram->frames[vicfpn];
+   struct rmap_struct *rm;
+   int swpfpn, swptyp, cached, shared;
+ 
+   /* All mappings of a shared frame move, lock them first */
+   pthread_mutex_lock(&rmap_lock);
+   shared = fr->mapcount > 0;
+   if (shared && rmap_trylock(fr, mm) != 0)
+   {
+     pthread_mutex_unlock(&rmap_lock);
+     return 1;
+   }
+   pthread_mutex_unlock(&rmap_lock);
+ 
+   /* A clean victim still has its copy in the swap cache, no write back */
+   cached = !(mm->pgd[vicpgn] & PAGING_PTE_DIRTY_MASK) &&
+            swap_cache_take(caller, vicfpn, &swptyp, &swpfpn) == 0;
+   if (!cached)
+     swap_cache_drop(caller, vicfpn);
+ 
+   /* Otherwise try to compress it into the zswap pool, then MEMSWP.
+    * A shared frame goes to a device slot all its mappings can share */
+   if (!cached && (shared ||
+                   zswap_store(caller, mm, vicpgn, vicfpn, &swptyp, &swpfpn) != 0))
+   {
+     /* Get free frame in MEMSWP, the device becomes the active swap */
+     if (swap_get_freefp(caller, &swptyp, &swpfpn) == -1)
+     {
+       if (shared)
+         rmap_unlock(fr, mm);
+       return -1; // No free frame in any MEMSWP
+     }
  
-   /* Get the page to MEMRAM, swap from MEMSWAP if needed */
-   if (pg_getpage(mm, pgn, &fpn, caller) != 0)
-     return -1; /* invalid page access */
+     /* Copy victim frame to swap, SYSCALL 17 sys_memmap. The copy is
+      * queued, a shared frame goes out before its mappings are let go */
+     if (memmap_queue(caller, SYSMEM_SWPOUT_OP, vicfpn, swpfpn, swptyp, 0, NULL, NULL) != 0 ||
+         (shared && memmap_submit(caller) != 0))
+     {
+       swap_put_freefp(caller, swptyp, swpfpn);
+       if (shared)
+         rmap_unlock(fr, mm);
+       return -1; // syscall failed
+     }
+   }
+   if (!cached)
+     caller->ru.ru_oublock += PAGING_PAGESZ;
  
-   /* TODO
-    *  MEMPHY_read(caller->mram, phyaddr, data);
-    *  MEMPHY READ
-    *  SYSCALL 17 sys_memmap with SYSMEM_IO_READ
-    */
-   int phyaddr = fpn * PAGING_PAGESZ + off;
-   struct sc_regs regs;
-   regs.a1 = SYSMEM_IO_READ;
-   regs.a2 = phyaddr;
-   regs.a3 = -1;
+   /* Move the other mappings of a shared frame to the same slot */
+   for (rm = fr->rmap; rm; rm = rm->rm_next)
+   {
+     int rmtyp = swptyp, rmoff = swpfpn;
  
-   /* SYSCALL 17 sys_memmap */
-   if (syscall(caller, 17, &regs) != 0)
+     if (rm->mm == mm && rm->pgn == vicpgn)
+       continue;
+     swap_dup(caller, rm->mm, rm->pgn, &rmtyp, &rmoff);
+     delist_pgn_node(rm->mm, rm->pgn);
+     pte_set_swap(&rm->mm->pgd[rm->pgn], rmtyp, rmoff);
+   }
+   if (shared)
    {
-     return -1; // syscall failed
+     rmap_unlock(fr, mm);
+     pthread_mutex_lock(&rmap_lock);
+     free_rmap_list(&fr->rmap);
+     fr->mapcount = 0;
+     pthread_mutex_unlock(&rmap_lock);
    }
  
-   // Update data
-   *data = (BYTE)regs.a3;
+   /* Update page table */
+   pte_set_swap(&mm->pgd[vicpgn], swptyp, swpfpn); // update the victim page table to swap out
  
    return 0;
  }
  
- /*pg_setval - write value to given offset
+ /*pg_split_huge - turn a huge page back into base pages
   *@mm: memory region
-  *@addr: virtual address to acess
-  *@value: value
+  *@pagenum: any PGN of the huge page
   *
+  * The frames stay where they are. The other pages join the FIFO list
+  * right behind the head page, or at the end when the head was just
+  * taken off as a victim, so they keep the age of the huge page.
   */
- int pg_setval(struct mm_struct *mm, int addr, BYTE value, struct pcb_t *caller)
+ static void pg_split_huge(struct mm_struct *mm, int pgn)
  {
-   int pgn = PAGING_PGN(addr);
-   int off = PAGING_OFFST(addr);
-   int fpn;
- 
-   /* Get the page to MEMRAM, swap from MEMSWAP if needed */
-   if (pg_getpage(mm, pgn, &fpn, caller) != 0)
-     return -1; /* invalid page access */
- 
-   /* TODO
-    *  MEMPHY_write(caller->mram, phyaddr, value);
-    *  MEMPHY WRITE
-    *  SYSCALL 17 sys_memmap with SYSMEM_IO_WRITE
-    */
-   int phyaddr = fpn * PAGING_PAGESZ + off;
-   struct sc_regs regs;
-   regs.a1 = SYSMEM_IO_WRITE;
-   regs.a2 = phyaddr;
-   regs.a3 = value;
- 
-   /* SYSCALL 17 sys_memmap */
-   if (syscall(caller, 17, &regs) != 0)
+   int head = pgn & ~(HPAGE_NR - 1);
+   struct pgn_t **pos = &mm->fifo_pgn;
+   int i;
+ 
+   while (*pos && (*pos)->pgn != head)
+     pos = &(*pos)->pg_next;
+   if (*pos)
+     pos = &(*pos)->pg_next;
+   else
+     mm->nr_resident += HPAGE_NR - 1; /* the head went off as a huge entry */
+ 
+   for (i = HPAGE_NR - 1; i >= 0; i--)
    {
-     return -1; // syscall failed
-   }
- 
-   // Update data
-   // data = (BYTE)
+     CLRBIT(mm->pgd[head + i], PAGING_PTE_HUGE_MASK);
+     if (i > 0)
+     {
+       struct pgn_t *pnode = malloc(sizeof(struct pgn_t));
  
-   return 0;
+       pnode->pgn = head + i;
+       pnode->pg_next = *pos;
+       *pos = pnode;
+     }
+   }
+   mm->hp_split++;
  }
  
- /*__read - read value in region memory
+ /*pg_evict - free a frame of ram by swapping a victim page out
+  *@mm: memory region
   *@caller: caller
-  *@vmaid: ID vm area to alloc memory region
-  *@offset: offset to acess in memory region
-  *@rgid: memory region ID (used to identify variable in symbole table)
-  *@size: allocated size
+  *@retfpn: return the freed FPN
   *
+  * A victim shared with a busy address space goes back to the head of
+  * the list and the next one is tried, each page at most once.
   */
- int __read(struct pcb_t *caller, int vmaid, int rgid, int offset, BYTE *data)
+ static int pg_evict(struct mm_struct *mm, struct pcb_t *caller, int *retfpn)
  {
-   /* Lock */
-   pthread_mutex_lock(&mmvm_lock);
+   struct pgn_t *pgit;
+   int vicpgn, vicfpn, ret, tries = 0;
  
-   struct vm_rg_struct *currg = get_symrg_byid(caller->mm, rgid);
-   struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
+   for (pgit = caller->mm->fifo_pgn; pgit; pgit = pgit->pg_next)
+     tries++;
  
-   if (currg == NULL || cur_vma == NULL)
-   { /* Invalid memory identify */
-     pthread_mutex_unlock(&mmvm_lock);
-     return -1;
-   }
+   do {
+     /* TODO: Play with your paging theory here */
+     /* Find victim page */
+     if (find_victim_page(caller->mm, &vicpgn) == -1)
+       return -1;                          // No victim page found
+     /* Huge pages go out one base page at a time */
+     if (mm->pgd[vicpgn] & PAGING_PTE_HUGE_MASK)
+       pg_split_huge(mm, vicpgn);
+     vicfpn = PAGING_FPN(mm->pgd[vicpgn]); // we need to swap this frame out
+ 
+     /* Read ahead but never used, the window was too large */
+     if (mm->pgd[vicpgn] & PAGING_PTE_READAHEAD_MASK)
+     {
+       mm->ra_miss++;
+       mm->ra_win /= 2;
+     }
+ 
+     if ((ret = pg_swapout(mm, vicpgn, caller)) != 0)
+       enlist_pgn_node(caller->mm, vicpgn);
+   } while (ret > 0 && --tries > 0);
  
-   pg_getval(caller->mm, currg->rg_start + offset, data, caller);
-   pthread_mutex_unlock(&mmvm_lock);
+   if (ret != 0)
+     return -1;
  
+   *retfpn = vicfpn;
    return 0;
  }
  
- /*libread - PAGING-based read a region memory */
- int libread(
-     struct pcb_t *proc, // Process executing the instruction
-     uint32_t source,    // Index of source register
-     uint32_t offset,    // Source address = [source] + [offset]
-     uint32_t *destination)
- {
+ /*mm_list_add - put an address space on the reclaim list
+  *@mm: memory region
+  *@owner: process the address space belongs to
+  */
+ void mm_list_add(struct mm_struct *mm, struct pcb_t *owner)
+ {
+   struct mm_struct **it;
+ 
+   mm->owner = owner;
+   mm->mm_next = NULL;
+   mm->oom_killed = 0;
+   pthread_mutex_lock(&mmlist_lock);
+   for (it = &mm_list; *it; it = &(*it)->mm_next)
+     ;
+   *it = mm;
+   nr_mm++;
+   pthread_mutex_unlock(&mmlist_lock);
+ }
+ 
+ /*mm_list_del - take an address space off the reclaim list
+  *@mm: memory region, not locked by the caller
+  */
+ static void mm_list_del(struct mm_struct *mm)
+ {
+   struct mm_struct **it;
+ 
+   pthread_mutex_lock(&mmlist_lock);
+   for (it = &mm_list; *it; it = &(*it)->mm_next)
+   {
+     if (*it == mm)
+     {
+       *it = mm->mm_next;
+       nr_mm--;
+       break;
+     }
+   }
+   pthread_mutex_unlock(&mmlist_lock);
+ }
+ 
+ /*mm_reclaim - swap out the oldest pages of the processes round-robin
+  *@caller: process that needs the frames, its own address space is
+  *         skipped, NULL for kswapd
+  *@nr: frames wanted
+  *
+  * Each address space gives at most RECLAIM_BATCH pages and moves to the
+  * end of the list. A busy one is skipped. Return the number of frames
+  * given back to MEMRAM.
+  */
+ int mm_reclaim(struct pcb_t *caller, int nr)
+ {
+   struct mm_struct *mm, **it;
+   struct pcb_t *owner;
+   int done = 0, tries, batch, fpn, stat;
+ 
+   pthread_mutex_lock(&mmlist_lock);
+   for (tries = nr_mm; tries > 0 && done < nr && (mm = mm_list) != NULL; tries--)
+   {
+     /* Rotate the head to the tail */
+     mm_list = mm->mm_next;
+     mm->mm_next = NULL;
+     for (it = &mm_list; *it; it = &(*it)->mm_next)
+       ;
+     *it = mm;
+ 
+     if ((caller != NULL && mm == caller->mm) ||
+         pthread_mutex_trylock(&mm->mm_lock) != 0)
+       continue;
+ 
+     /* The list may change meanwhile, the locked mm stays until unlocked */
+     owner = mm->owner;
+     pthread_mutex_unlock(&mmlist_lock);
+     for (batch = 0; batch < RECLAIM_BATCH && done < nr; batch++, done++)
+     {
+       if (pg_evict(mm, owner, &fpn) != 0)
+         break;
+       /* The copy to swap is queued on the ring of the owner */
+       stat = memmap_submit(owner);
+       MEMPHY_put_freefp(owner->mram, fpn);
+       if (stat != 0)
+         break;
+     }
+     pthread_mutex_unlock(&mm->mm_lock);
+     pthread_mutex_lock(&mmlist_lock);
+   }
+   pthread_mutex_unlock(&mmlist_lock);
+ 
+   return done;
+ }
+ 
+ /*pg_alloc_frame - get a frame of ram, evict a page if ram is full
+  *@mm: memory region
+  *@caller: caller
+  *@retfpn: return FPN
+  *@unlock: the caller holds no lock but its own mm_lock and reads again
+  *         whatever of its address space it needs after this returns
+  *
+  * With no page of its own to evict the caller takes one from another
+  * process. Dropping under the low watermark wakes kswapd. When nothing
+  * can be evicted anywhere a process is killed to make room.
+  *
+  * Between rounds of direct reclaim the caller backs off with its mm_lock
+  * released when @unlock allows, the others only try that lock and could
+  * not reclaim its pages meanwhile. Otherwise the rounds follow
+  * each other without a wait.
+  */
+ static int pg_alloc_frame(struct mm_struct *mm, struct pcb_t *caller, int *retfpn, int unlock)
+ {
+   struct timespec backoff = { 0, 10000 };
+   int got, retry;
+ 
+   /* A killed process only waits for its CPU to end it */
+   if (caller->mm->oom_killed)
+     return -1;
+ 
+   /* The frame may have been one a queued operation refers to */
+   if (memmap_submit(caller) != 0)
+     return -1;
+ 
+   got = MEMPHY_get_freefp(caller->mram, retfpn);
+   kswapd_wakeup(caller->mram);
+   if (got == 0 || pg_evict(mm, caller, retfpn) == 0)
+     return 0;
+ 
+   /* Direct reclaim, the other processes may be busy for a while or
+    * someone else may take the frame first */
+   for (retry = 0; retry < RECLAIM_RETRY; retry++)
+   {
+     if (try_to_free_pages(caller) != 0 && unlock)
+     {
+       pthread_mutex_unlock(&caller->mm->mm_lock);
+       nanosleep(&backoff, NULL);
+       pthread_mutex_lock(&caller->mm->mm_lock);
+       if (caller->mm->oom_killed)
+         return -1;
+     }
+     if (MEMPHY_get_freefp(caller->mram, retfpn) == 0)
+       return 0;
+   }
+ 
+   /* RAM and swap are full, someone else may still take the frame */
+   while (out_of_memory(caller) == 0)
+     if (MEMPHY_get_freefp(caller->mram, retfpn) == 0)
+       return 0;
+ 
+   return -1;
+ }
+ 
+ /*pg_swapin - bring one swapped page back to ram
+  *@mm: memory region
+  *@pagenum: PGN
+  *@caller: caller
+  *
+  */
+ static int pg_swapin(struct mm_struct *mm, int pgn, struct pcb_t *caller)
+ {
+   uint32_t pte = mm->pgd[pgn];
+   struct memphy_struct *tgtswp;
+   int tgtfpn, fpn;
+ 
+   if (!(pte & PAGING_PTE_SWAPPED_MASK))
+     return -1; // Page was never mapped
+ 
+   if (pg_alloc_frame(caller->mm, caller, &fpn, mm == caller->mm) != 0)
+     return -1;
+ 
+   /* The eviction or the backoff may have written a pooled page back,
+    * read the PTE again */
+   pte = mm->pgd[pgn];
+   tgtfpn = PAGING_PTE_SWP(pte); // the target frame storing our variable
+ 
+   /* Pooled page, decompress it instead of reading a device */
+   if (PAGING_PTE_SWPTYP(pte) == PAGING_ZSWAP_SWPTYP)
+   {
+     if (memmap_submit(caller) != 0 || zswap_load(caller, tgtfpn, fpn) != 0)
+     {
+       MEMPHY_put_freefp(caller->mram, fpn);
+       return -1;
+     }
+   }
+   else
+   {
+     zswap_miss();
+ 
+     // Don't have any choices, bring the whole page back in one transfer,
+     // queued behind the eviction that freed the frame
+     tgtswp = swap_device(caller, PAGING_PTE_SWPTYP(pte));
+     if (tgtswp == NULL ||
+         memmap_queue(caller, SYSMEM_SWPIN_OP, fpn, tgtfpn,
+                      PAGING_PTE_SWPTYP(pte), 0, NULL, NULL) != 0)
+     {
+       memmap_submit(caller);
+       MEMPHY_put_freefp(caller->mram, fpn);
+       return -1;
+     }
+ 
+     /* The slot it came from stays reserved as its swap cache while
+      * the page is clean */
+     swap_cache_add(caller, fpn, PAGING_PTE_SWPTYP(pte), tgtfpn);
+   }
+ 
+   /* Update its online status of the target page */
+   pte_set_fpn(&mm->pgd[pgn], fpn);
+ 
+   enlist_pgn_node(mm, pgn);
+   caller->ru.ru_inblock += PAGING_PAGESZ;
+ 
+   return 0;
+ }
+ 
+ /*pg_zero_frame - get the shared zero frame of ram
+  *@mm: memory region
+  *@caller: caller
+  *
+  * The frame is taken on first use and never given back, nothing is
+  * ever written to it.
+  */
+ static int pg_zero_frame(struct mm_struct *mm, struct pcb_t *caller)
+ {
+   BYTE page[PAGING_PAGESZ];
+   int fpn, zfpn;
+ 
+   pthread_mutex_lock(&rmap_lock);
+   zfpn = caller->mram->zero_fpn;
+   pthread_mutex_unlock(&rmap_lock);
+   if (zfpn >= 0)
+     return zfpn;
+ 
+   if (pg_alloc_frame(mm, caller, &fpn, mm == caller->mm) != 0 ||
+       memmap_submit(caller) != 0)
+     return -1;
+ 
+   memset(page, 0, sizeof(page));
+   MEMPHY_write_page(caller->mram, fpn, page);
+ 
+   /* Another process may have set it up meanwhile */
+   pthread_mutex_lock(&rmap_lock);
+   if ((zfpn = caller->mram->zero_fpn) < 0)
+     zfpn = caller->mram->zero_fpn = fpn;
+   pthread_mutex_unlock(&rmap_lock);
+   if (zfpn != fpn)
+     MEMPHY_put_freefp(caller->mram, fpn);
+ 
+   return zfpn;
+ }
+ 
+ /*pg_share_frame - map a frame of ram into one more page table
+  *@caller: caller
+  *@fpn: frame
+  *@ownmm: memory region of a mapping the frame already has
+  *@ownpgn: PGN of that mapping
+  *@mm: memory region of the new mapping
+  *@pagenum: PGN of the new mapping
+  *
+  */
+ static void pg_share_frame(struct pcb_t *caller, int fpn, struct mm_struct *ownmm, int ownpgn,
+                            struct mm_struct *mm, int pgn)
+ {
+   struct frame_struct *fr = &caller->mram->frames[fpn];
+ 
+   pthread_mutex_lock(&rmap_lock);
+   if (fr->mapcount++ == 0)
+     enlist_rmap_node(&fr->rmap, ownmm, ownpgn);
+   enlist_rmap_node(&fr->rmap, mm, pgn);
+   pthread_mutex_unlock(&rmap_lock);
+ }
+ 
+ /*pg_put_frame - drop one mapping of a frame of ram
+  *@caller: caller
+  *@mm: memory region of the mapping
+  *@pagenum: PGN of the mapping
+  *@fpn: frame
+  *
+  * The frame goes back to MEMRAM with its last mapping, the zero frame
+  * never does.
+  */
+ static void pg_put_frame(struct pcb_t *caller, struct mm_struct *mm, int pgn, int fpn)
+ {
+   struct frame_struct *fr = &caller->mram->frames[fpn];
+ 
+   pthread_mutex_lock(&rmap_lock);
+   if (fpn == caller->mram->zero_fpn)
+   {
+     pthread_mutex_unlock(&rmap_lock);
+     return;
+   }
+ 
+   if (fr->mapcount > 0)
+   {
+     delist_rmap_node(&fr->rmap, mm, pgn);
+     if (--fr->mapcount == 0)
+       free_rmap_list(&fr->rmap); // a single mapping needs no reverse map
+     pthread_mutex_unlock(&rmap_lock);
+     return;
+   }
+   pthread_mutex_unlock(&rmap_lock);
+ 
+   swap_cache_drop(caller, fpn);
+   MEMPHY_put_freefp(caller->mram, fpn);
+ }
+ 
+ /*pg_wpfault - give a write protected page its own frame
+  *@mm: memory region
+  *@pagenum: PGN
+  *@caller: caller
+  *
+  * The content of the shared frame is copied, for the zero frame this
+  * makes a zero filled page. The last mapping of a forked frame takes
+  * it over without a copy.
+  */
+ static int pg_wpfault(struct mm_struct *mm, int pgn, struct pcb_t *caller)
+ {
+   int srcfpn = PAGING_FPN(mm->pgd[pgn]);
+   int zero, shared, fpn;
+ 
+   caller->ru.ru_minflt++;
+   pthread_mutex_lock(&rmap_lock);
+   zero = (srcfpn == caller->mram->zero_fpn);
+   shared = zero || caller->mram->frames[srcfpn].mapcount > 0;
+   pthread_mutex_unlock(&rmap_lock);
+ 
+   if (!shared)
+   {
+     CLRBIT(mm->pgd[pgn], PAGING_PTE_COW_MASK);
+     return 0;
+   }
+ 
+   /* The page must not be its own victim while the copy is made. A forked
+    * frame may be evicted through its other mappings, the zero frame never
+    * changes and only for it the lock may be dropped */
+   delist_pgn_node(mm, pgn);
+   if (pg_alloc_frame(mm, caller, &fpn, zero && mm == caller->mm) != 0 ||
+       memmap_submit(caller) != 0 ||
+       __swap_cp_page(caller->mram, srcfpn, caller->mram, fpn) != 0)
+   {
+     if (!zero)
+       enlist_pgn_node(mm, pgn);
+     return -1;
+   }
+ 
+   pg_put_frame(caller, mm, pgn, srcfpn);
+   CLRBIT(mm->pgd[pgn], PAGING_PTE_COW_MASK);
+   pte_set_fpn(&mm->pgd[pgn], fpn);
+   enlist_pgn_node(caller->mm, pgn);
+ 
+   return 0;
+ }
+ 
+ /*pg_release - give the frame or swap frame of a page back
+  *@mm: memory region
+  *@pagenum: PGN
+  *@caller: caller
+  *
+  * The page stays reserved, a later touch faults in a fresh zero page.
+  */
+ static void pg_release(struct mm_struct *mm, int pgn, struct pcb_t *caller)
+ {
+   uint32_t pte = mm->pgd[pgn];
+ 
+   /* The rest of a huge page stays mapped as base pages */
+   if (pte & PAGING_PTE_HUGE_MASK)
+   {
+     pg_split_huge(mm, pgn);
+     pte = mm->pgd[pgn];
+   }
+ 
+   if (PAGING_PAGE_PRESENT(pte))
+   {
+     delist_pgn_node(mm, pgn);
+     pg_put_frame(caller, mm, pgn, PAGING_FPN(pte));
+   }
+   else if (pte & PAGING_PTE_SWAPPED_MASK)
+   {
+     swap_put_freefp(caller, PAGING_PTE_SWPTYP(pte), PAGING_PTE_SWP(pte));
+   }
+   else
+   {
+     return; // Nothing backs the page
+   }
+ 
+   mm->pgd[pgn] = 0;
+   pte_set_reserve(&mm->pgd[pgn]);
+ }
+ 
+ /*pg_readahead - bring the swapped neighbours of a faulting page in
+  *@mm: memory region
+  *@pagenum: PGN that just faulted
+  *@caller: caller
+  *
+  * A fault right after the previous one, or at the end of the last
+  * window, is a sequential scan and doubles the window. Any other fault
+  * is random access and disables readahead. Pages read ahead are marked
+  * until first touched, evicting them untouched halves the window.
+  */
+ static void pg_readahead(struct mm_struct *mm, int pgn, struct pcb_t *caller)
+ {
+   struct vm_area_struct *vma;
+   int rapgn, endpgn;
+ 
+   if (pgn == mm->ra_prev_pgn + 1 || pgn == mm->ra_next_pgn)
+     mm->ra_win = mm->ra_win ? mm->ra_win * 2 : SWAP_RA_MIN;
+   else
+     mm->ra_win = 0;
+   if (mm->ra_win > SWAP_RA_MAX)
+     mm->ra_win = SWAP_RA_MAX;
+   mm->ra_prev_pgn = pgn;
+ 
+   /* Keep the window within half of the resident pages, so a cluster
+    * never pushes out its own pages */
+   if (mm->ra_win > mm->nr_resident / 2)
+     mm->ra_win = mm->nr_resident / 2;
+ 
+   /* Stay inside the area the page belongs to */
+   vma = find_vma(mm, pgn * PAGING_PAGESZ);
+   if (vma != NULL && pgn * PAGING_PAGESZ >= vma->sbrk)
+     vma = NULL;
+   if (vma == NULL || mm->ra_win == 0)
+     return;
+ 
+   endpgn = pgn + 1 + mm->ra_win;
+   if (endpgn > (int)DIV_ROUND_UP(vma->sbrk, PAGING_PAGESZ))
+     endpgn = DIV_ROUND_UP(vma->sbrk, PAGING_PAGESZ);
+   mm->ra_next_pgn = endpgn;
+ 
+   /* The faulting page must not be picked as a victim by its own cluster,
+    * busy victims are rotated so the window bound alone is not enough */
+   delist_pgn_node(mm, pgn);
+   for (rapgn = pgn + 1; rapgn < endpgn; rapgn++)
+   {
+     if (!(mm->pgd[rapgn] & PAGING_PTE_SWAPPED_MASK) || PAGING_PAGE_PRESENT(mm->pgd[rapgn]) ||
+         shm_find_page(mm, rapgn, NULL) != NULL)
+       continue;
+     if (pg_swapin(mm, rapgn, caller) != 0)
+       break;
+     SETBIT(mm->pgd[rapgn], PAGING_PTE_READAHEAD_MASK);
+   }
+   enlist_pgn_node(mm, pgn);
+ }
+ 
+ /*pg_huge_fault - map the huge page around a first touched page
+  *@mm: memory region
+  *@pagenum: PGN that faulted
+  *@caller: caller
+  *
+  * Only an aligned run of HPAGE_NR untouched pages wholly below the break
+  * of one area qualifies. It gets a zero filled block of contiguous
+  * frames and a single FIFO entry. No page is evicted to make room for
+  * the block, return -1 to fall back to a base page.
+  */
+ static int pg_huge_fault(struct mm_struct *mm, int pgn, struct pcb_t *caller)
+ {
+   BYTE page[PAGING_PAGESZ];
+   struct vm_area_struct *vma;
+   int head = pgn & ~(HPAGE_NR - 1);
+   int fpn, i;
+ 
+   if (!hpage_enabled)
+     return -1;
+ 
+   vma = find_vma(mm, head * PAGING_PAGESZ);
+   if (vma == NULL || (head + HPAGE_NR) * PAGING_PAGESZ > vma->sbrk)
+     return -1;
+   for (i = 0; i < HPAGE_NR; i++)
+     if (mm->pgd[head + i] != PAGING_PTE_RESERVE_MASK)
+       return -1;
+   if (shm_find_page(mm, head, NULL) != NULL ||
+       MEMPHY_get_freefp_order(caller->mram, HPAGE_ORDER, &fpn) != 0)
+     return -1;
+ 
+   memset(page, 0, sizeof(page));
+   for (i = 0; i < HPAGE_NR; i++)
+   {
+     MEMPHY_write_page(caller->mram, fpn + i, page);
+     pte_set_fpn(&mm->pgd[head + i], fpn + i);
+     SETBIT(mm->pgd[head + i], PAGING_PTE_HUGE_MASK);
+   }
+   enlist_pgn_node(mm, head);
+   mm->hp_fault++;
+ 
+   return 0;
+ }
+ 
+ /*hpage_enable - map large untouched runs as huge pages
+  *@on: enable
+  */
+ void hpage_enable(int on)
+ {
+   hpage_enabled = on;
+ }
+ 
+ /*pg_shm_fault - map a page of a shared memory segment
+  *@mm: memory region
+  *@pagenum: PGN
+  *@seg: segment the page is attached to
+  *@segpgn: PGN inside the segment
+  *@caller: caller
+  *
+  * The segment brings its page in, zero filled on first use, and every
+  * attached page table shares that frame. A swap frame still held by
+  * this mapping is given back.
+  */
+ static int pg_shm_fault(struct mm_struct *mm, int pgn, struct shm_struct *seg, int segpgn,
+                         struct pcb_t *caller)
+ {
+   struct mm_struct *segmm = seg->mm;
+   BYTE page[PAGING_PAGESZ];
+   uint32_t pte;
+   int fpn;
+ 
+   pthread_mutex_lock(&segmm->mm_lock);
+   if (!PAGING_PAGE_PRESENT(segmm->pgd[segpgn]))
+   {
+     if (segmm->pgd[segpgn] & PAGING_PTE_SWAPPED_MASK)
+     {
+       /* Other processes see the frame once the segment is unlocked */
+       if (pg_swapin(segmm, segpgn, caller) != 0 || memmap_submit(caller) != 0)
+       {
+         pthread_mutex_unlock(&segmm->mm_lock);
+         return -1;
+       }
+       delist_pgn_node(segmm, segpgn); // a segment never picks victims
+       caller->ru.ru_majflt++;
+     }
+     else
+     {
+       if (pg_alloc_frame(caller->mm, caller, &fpn, 0) != 0 ||
+           memmap_submit(caller) != 0)
+       {
+         pthread_mutex_unlock(&segmm->mm_lock);
+         return -1;
+       }
+       memset(page, 0, sizeof(page));
+       MEMPHY_write_page(caller->mram, fpn, page);
+       pte_set_fpn(&segmm->pgd[segpgn], fpn);
+       caller->ru.ru_minflt++;
+     }
+   }
+   else
+   {
+     caller->ru.ru_minflt++;
+   }
+   fpn = PAGING_FPN(segmm->pgd[segpgn]);
+ 
+   pte = mm->pgd[pgn];
+   if (pte & PAGING_PTE_SWAPPED_MASK)
+     swap_put_freefp(caller, PAGING_PTE_SWPTYP(pte), PAGING_PTE_SWP(pte));
+ 
+   pte_set_fpn(&mm->pgd[pgn], fpn);
+   pg_share_frame(caller, fpn, segmm, segpgn, mm, pgn);
+   pthread_mutex_unlock(&segmm->mm_lock);
+   enlist_pgn_node(mm, pgn);
+ 
+   return 0;
+ }
+ 
+ /*pg_getpage - get the page in ram
+  *@mm: memory region
+  *@pagenum: PGN
+  *@framenum: return FPN
+  *@caller: caller
+  *
+  */
+ int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
+ {
+   /* Check the validation */
+   if (mm == NULL || pgn < 0 || pgn > PAGING_MAX_PGN || fpn == NULL || caller == NULL)
+     return -1;
+ 
+   uint32_t pte = mm->pgd[pgn];
+   struct shm_struct *seg;
+   int segpgn;
+ 
+   if (!PAGING_PAGE_PRESENT(pte) && (seg = shm_find_page(mm, pgn, &segpgn)) != NULL)
+   { /* Shared memory, every attached process maps the same frame */
+     if (pg_shm_fault(mm, pgn, seg, segpgn, caller) != 0)
+       return -1;
+   }
+   else if (!PAGING_PAGE_PRESENT(pte) && (pte & PAGING_PTE_SWAPPED_MASK))
+   {
+     if (pg_swapin(mm, pgn, caller) != 0)
+       return -1;
+     caller->ru.ru_majflt++;
+     pff_fault(caller);
+     pg_readahead(mm, pgn, caller);
+   }
+   else if (!PAGING_PAGE_PRESENT(pte))
+   { /* Never touched, map the zero frame until the first write */
+     int zfpn;
+ 
+     if (!(pte & PAGING_PTE_RESERVE_MASK))
+       return -1; // Page was never allocated
+     caller->ru.ru_minflt++;
+ 
+     /* A large untouched run is mapped whole and writable at once */
+     if (pg_huge_fault(mm, pgn, caller) != 0)
+     {
+       if ((zfpn = pg_zero_frame(mm, caller)) < 0)
+         return -1;
+       pte_set_fpn(&mm->pgd[pgn], zfpn);
+       SETBIT(mm->pgd[pgn], PAGING_PTE_COW_MASK);
+     }
+   }
+   else if (pte & PAGING_PTE_READAHEAD_MASK)
+   { /* First touch of a page read ahead */
+     CLRBIT(mm->pgd[pgn], PAGING_PTE_READAHEAD_MASK);
+     mm->ra_hit++;
+   }
+ 
+   *fpn = PAGING_FPN(mm->pgd[pgn]);
+ 
+   return 0;
+ }
+ 
+ /*pg_getpage_write - get the page in ram ready to be written
+  *@mm: memory region
+  *@pagenum: PGN
+  *@framenum: return FPN
+  *@caller: caller
+  *
+  * A shared frame is copied first. The page is dirty afterwards, its
+  * swapped copy is stale.
+  */
+ static int pg_getpage_write(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
+ {
+   if (pg_getpage(mm, pgn, fpn, caller) != 0)
+     return -1;
+ 
+   /* Shared frame, the page needs its own copy first */
+   if (mm->pgd[pgn] & PAGING_PTE_COW_MASK)
+   {
+     if (pg_wpfault(mm, pgn, caller) != 0)
+       return -1;
+     *fpn = PAGING_FPN(mm->pgd[pgn]);
+   }
+ 
+   if (!(mm->pgd[pgn] & PAGING_PTE_DIRTY_MASK))
+   {
+     SETBIT(mm->pgd[pgn], PAGING_PTE_DIRTY_MASK);
+     swap_cache_drop(caller, *fpn);
+   }
+ 
+   return 0;
+ }
+ 
+ /*pg_getval - read value at given offset
+  *@mm: memory region
+  *@addr: virtual address to acess
+  *@data: return value
+  *@caller: caller
+  */
+ int pg_getval(struct mm_struct *mm, int addr, BYTE *data, struct pcb_t *caller)
+ {
+   int pgn = PAGING_PGN(addr);
+   int off = PAGING_OFFST(addr);
+   int fpn;
+ 
+   uint64_t val;
+ 
+   /* Get the page to MEMRAM, swap from MEMSWAP if needed */
+   if (pg_getpage(mm, pgn, &fpn, caller) != 0)
+   {
+     memmap_submit(caller);
+     return -1; /* invalid page access */
+   }
+ 
+   /* MEMPHY READ, SYSCALL 17 sys_memmap with SYSMEM_IO_READ. A single
+    * submit runs it with the copies of the fault */
+   int phyaddr = fpn * PAGING_PAGESZ + off;
+   if (memmap_queue(caller, SYSMEM_IO_READ, phyaddr, -1, 0, 0, NULL, &val) != 0 ||
+       memmap_submit(caller) != 0)
+     return -1; // syscall failed
+ 
+   // Update data
+   *data = (BYTE)val;
+ 
+   return 0;
+ }
+ 
+ /*pg_setval - write value to given offset
+  *@mm: memory region
+  *@addr: virtual address to acess
+  *@value: value
+  *
+  */
+ int pg_setval(struct mm_struct *mm, int addr, BYTE value, struct pcb_t *caller)
+ {
+   int pgn = PAGING_PGN(addr);
+   int off = PAGING_OFFST(addr);
+   int fpn;
+ 
+   /* Get the page to MEMRAM with a frame of its own */
+   if (pg_getpage_write(mm, pgn, &fpn, caller) != 0)
+   {
+     memmap_submit(caller);
+     return -1; /* invalid page access */
+   }
+ 
+   /* MEMPHY WRITE, SYSCALL 17 sys_memmap with SYSMEM_IO_WRITE. A single
+    * submit runs it with the copies of the fault */
+   int phyaddr = fpn * PAGING_PAGESZ + off;
+   if (memmap_queue(caller, SYSMEM_IO_WRITE, phyaddr, value, 0, 0, NULL, NULL) != 0 ||
+       memmap_submit(caller) != 0)
+     return -1; // syscall failed
+ 
+   return 0;
+ }
+ 
+ /*__read - read value in region memory
+  *@caller: caller
+  *@vmaid: ID vm area to alloc memory region
+  *@offset: offset to acess in memory region
+  *@rgid: memory region ID (used to identify variable in symbole table)
+  *@size: allocated size
+  *
+  */
+ int __read(struct pcb_t *caller, int vmaid, int rgid, int offset, BYTE *data)
+ {
+   /* Lock */
+   pthread_mutex_lock(&caller->mm->mm_lock);
+ 
+   struct vm_rg_struct *currg = get_symrg_byid(caller->mm, rgid);
+   struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
+ 
+   if (currg == NULL || cur_vma == NULL)
+   { /* Invalid memory identify */
+     pthread_mutex_unlock(&caller->mm->mm_lock);
+     return -1;
+   }
+ 
+   /* A page that cannot be brought in leaves data unset */
+   int val = pg_getval(caller->mm, currg->rg_start + offset, data, caller);
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+ 
+   return val;
+ }
+ 
+ /*libread - PAGING-based read a region memory */
+ int libread(
+     struct pcb_t *proc, // Process executing the instruction
+     uint32_t source,    // Index of source register
+     uint32_t offset,    // Source address = [source] + [offset]
+     uint32_t *destination)
+ {
    BYTE data;
    int val = __read(proc, 0, source, offset, &data);
  
    if (val != 0)
      return -1; // read failed
  
-   /* TODO update result of reading action*/
-   *destination = (uint32_t)data;
+   /* TODO update result of reading action*/
+   *destination = (uint32_t)data;
+ #ifdef IODUMP
+   printf("read region=%d offset=%d value=%d\n", source, offset, data);
+ #ifdef PAGETBL_DUMP
+   print_pgtbl(proc, 0, -1); // print max TBL
+ #endif
+   MEMPHY_dump(proc->mram);
+ #endif
+ 
+   return val;
+ }
+ 
+ /*__write - write a region memory
+  *@caller: caller
+  *@vmaid: ID vm area to alloc memory region
+  *@offset: offset to acess in memory region
+  *@rgid: memory region ID (used to identify variable in symbole table)
+  *@size: allocated size
+  *
+  */
+ int __write(struct pcb_t *caller, int vmaid, int rgid, int offset, BYTE value)
+ {
+   /* Lock */
+   pthread_mutex_lock(&caller->mm->mm_lock);
+ 
+   struct vm_rg_struct *currg = get_symrg_byid(caller->mm, rgid);
+   struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
+ 
+   if (currg == NULL || cur_vma == NULL)
+   { /* Invalid memory identify */
+     pthread_mutex_unlock(&caller->mm->mm_lock);
+     return -1;
+   }
+ 
+   pg_setval(caller->mm, currg->rg_start + offset, value, caller);
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+ 
+   return 0;
+ }
+ 
+ /*libwrite - PAGING-based write a region memory */
+ int libwrite(
+     struct pcb_t *proc,   // Process executing the instruction
+     BYTE data,            // Data to be wrttien into memory
+     uint32_t destination, // Index of destination register
+     uint32_t offset)
+ {
+ #ifdef IODUMP
+   printf("write region=%d offset=%d value=%d\n", destination, offset, data);
+ #ifdef PAGETBL_DUMP
+   print_pgtbl(proc, 0, -1); // print max TBL
+ #endif
+   MEMPHY_dump(proc->mram);
+ #endif
+ 
+   return __write(proc, 0, destination, offset, data);
+ }
+ 
+ /*rg_range - check a byte range of a region memory
+  *@caller: caller
+  *@vmaid: ID vm area the region belongs to
+  *@rgid: memory region ID
+  *@offset: offset of the range in the region
+  *@size: length of the range
+  *
+  * Return the address the range starts at, -1 when it leaves the region.
+  * A freed region is -1 to -1 and an unused one 0 to 0, both are empty.
+  */
+ static int rg_range(struct pcb_t *caller, int vmaid, int rgid, int offset, int size)
+ {
+   struct vm_rg_struct *currg = get_symrg_byid(caller->mm, rgid);
+ 
+   if (currg == NULL || get_vma_by_num(caller->mm, vmaid) == NULL ||
+       currg->rg_start >= currg->rg_end || offset < 0 || size < 0 ||
+       (unsigned long)offset > currg->rg_end - currg->rg_start ||
+       (unsigned long)size > currg->rg_end - currg->rg_start - offset)
+     return -1;
+ 
+   return currg->rg_start + offset;
+ }
+ 
+ /*pg_getval_word - read a little endian word at given address
+  *@mm: memory region
+  *@addr: virtual address to acess
+  *@width: number of bytes, up to 8
+  *@data: return value
+  *@caller: caller
+  *
+  * A word crossing a page boundary is split in one access per page.
+  */
+ static int pg_getval_word(struct mm_struct *mm, int addr, int width, uint64_t *data, struct pcb_t *caller)
+ {
+   uint64_t part[2] = {0, 0};
+   int at[2];
+   int done, len, fpn, n = 0;
+ 
+   /* Both parts go in one batch */
+   for (done = 0; done < width; done += len)
+   {
+     len = width - done;
+     if (PAGING_PAGESZ - PAGING_OFFST((addr + done)) < len)
+       len = PAGING_PAGESZ - PAGING_OFFST((addr + done));
+ 
+     if (pg_getpage(mm, PAGING_PGN((addr + done)), &fpn, caller) != 0 ||
+         memmap_queue(caller, SYSMEM_IO_READW,
+                      fpn * PAGING_PAGESZ + PAGING_OFFST((addr + done)),
+                      0, len, 0, NULL, &part[n]) != 0)
+     {
+       memmap_submit(caller);
+       return -1; /* invalid page access */
+     }
+     at[n++] = done;
+   }
+ 
+   if (memmap_submit(caller) != 0)
+     return -1;
+ 
+   *data = 0;
+   while (n-- > 0)
+     *data |= part[n] << (8 * at[n]);
+ 
+   return 0;
+ }
+ 
+ /*pg_setval_word - write a little endian word at given address
+  *@mm: memory region
+  *@addr: virtual address to acess
+  *@width: number of bytes, up to 8
+  *@value: value
+  *@caller: caller
+  */
+ static int pg_setval_word(struct mm_struct *mm, int addr, int width, uint64_t value, struct pcb_t *caller)
+ {
+   uint64_t part;
+   int done, len, fpn;
+ 
+   for (done = 0; done < width; done += len)
+   {
+     len = width - done;
+     if (PAGING_PAGESZ - PAGING_OFFST((addr + done)) < len)
+       len = PAGING_PAGESZ - PAGING_OFFST((addr + done));
+ 
+     part = value >> (8 * done);
+     if (pg_getpage_write(mm, PAGING_PGN((addr + done)), &fpn, caller) != 0 ||
+         memmap_queue(caller, SYSMEM_IO_WRITEW,
+                      fpn * PAGING_PAGESZ + PAGING_OFFST((addr + done)),
+                      (uint32_t)part, len, (uint32_t)(part >> 32), NULL, NULL) != 0)
+     {
+       memmap_submit(caller);
+       return -1; /* invalid page access */
+     }
+   }
+ 
+   return memmap_submit(caller);
+ }
+ 
+ /*__read_word - read a 16/32/64-bit value in region memory
+  *@caller: caller
+  *@vmaid: ID vm area the region belongs to
+  *@rgid: memory region ID (used to identify variable in symbole table)
+  *@offset: offset to acess in memory region
+  *@width: value size in bytes, 2, 4 or 8
+  *@data: return value
+  */
+ int __read_word(struct pcb_t *caller, int vmaid, int rgid, int offset, int width, uint64_t *data)
+ {
+   int addr, stat;
+ 
+   if (width != 2 && width != 4 && width != 8)
+     return -1;
+ 
+   /* Lock */
+   pthread_mutex_lock(&caller->mm->mm_lock);
+   if ((addr = rg_range(caller, vmaid, rgid, offset, width)) < 0)
+     stat = -1;
+   else
+     stat = pg_getval_word(caller->mm, addr, width, data, caller);
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+ 
+   return stat;
+ }
+ 
+ /*__write_word - write a 16/32/64-bit value in region memory
+  *@caller: caller
+  *@vmaid: ID vm area the region belongs to
+  *@rgid: memory region ID (used to identify variable in symbole table)
+  *@offset: offset to acess in memory region
+  *@width: value size in bytes, 2, 4 or 8
+  *@value: value, truncated to the width
+  */
+ int __write_word(struct pcb_t *caller, int vmaid, int rgid, int offset, int width, uint64_t value)
+ {
+   int addr, stat;
+ 
+   if (width != 2 && width != 4 && width != 8)
+     return -1;
+ 
+   /* Lock */
+   pthread_mutex_lock(&caller->mm->mm_lock);
+   if ((addr = rg_range(caller, vmaid, rgid, offset, width)) < 0)
+     stat = -1;
+   else
+     stat = pg_setval_word(caller->mm, addr, width, value, caller);
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+ 
+   return stat;
+ }
+ 
+ /*libreadw - PAGING-based read a 16/32/64-bit value of a region memory */
+ int libreadw(
+     struct pcb_t *proc, // Process executing the instruction
+     uint32_t source,    // Index of source register
+     uint32_t offset,    // Source address = [source] + [offset]
+     uint32_t width,     // Value size in bytes
+     uint64_t *destination)
+ {
+   uint64_t data;
+   int val = __read_word(proc, 0, source, offset, width, &data);
+ 
+   if (val != 0)
+     return -1; // read failed
+ 
+   *destination = data;
  #ifdef IODUMP
-   printf("read region=%d offset=%d value=%d\n", source, offset, data);
+   printf("read%d region=%d offset=%d value=%llu\n", width * 8, source, offset,
+          (unsigned long long)data);
  #ifdef PAGETBL_DUMP
    print_pgtbl(proc, 0, -1); // print max TBL
  #endif
@@ -510,56 +1842,213 @@
    return val;
  }
  
- /*__write - write a region memory
+ /*libwritew - PAGING-based write a 16/32/64-bit value of a region memory */
+ int libwritew(
+     struct pcb_t *proc,   // Process executing the instruction
+     uint64_t data,        // Data to be wrttien into memory
+     uint32_t destination, // Index of destination register
+     uint32_t offset,      // Destination address = [destination] + [offset]
+     uint32_t width)       // Value size in bytes
+ {
+ #ifdef IODUMP
+   printf("write%d region=%d offset=%d value=%llu\n", width * 8, destination, offset,
+          (unsigned long long)data);
+ #ifdef PAGETBL_DUMP
+   print_pgtbl(proc, 0, -1); // print max TBL
+ #endif
+   MEMPHY_dump(proc->mram);
+ #endif
+ 
+   return __write_word(proc, 0, destination, offset, width, data);
+ }
+ 
+ /*__memset - fill a range of a region memory
   *@caller: caller
   *@vmaid: ID vm area to alloc memory region
-  *@offset: offset to acess in memory region
   *@rgid: memory region ID (used to identify variable in symbole table)
-  *@size: allocated size
+  *@offset: offset of the range in the region
+  *@value: fill byte
+  *@size: length of the range
   *
+  * Every page is faulted once and filled with a single page transfer.
+  * The transfers are batched, all full pages write the same buffer.
   */
- int __write(struct pcb_t *caller, int vmaid, int rgid, int offset, BYTE value)
+ int __memset(struct pcb_t *caller, int vmaid, int rgid, int offset, BYTE value, int size)
  {
+   BYTE page[PAGING_PAGESZ], fill[PAGING_PAGESZ];
+   int addr, end, off, len, fpn;
+ 
    /* Lock */
-   pthread_mutex_lock(&mmvm_lock);
+   pthread_mutex_lock(&caller->mm->mm_lock);
  
-   struct vm_rg_struct *currg = get_symrg_byid(caller->mm, rgid);
-   struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
+   if ((addr = rg_range(caller, vmaid, rgid, offset, size)) < 0)
+   {
+     pthread_mutex_unlock(&caller->mm->mm_lock);
+     return -1;
+   }
  
-   if (currg == NULL || cur_vma == NULL)
-   { /* Invalid memory identify */
-     pthread_mutex_unlock(&mmvm_lock);
+   memset(fill, value, PAGING_PAGESZ);
+   for (end = addr + size; addr < end; addr += len)
+   {
+     off = PAGING_OFFST(addr);
+     len = end - addr < PAGING_PAGESZ - off ? end - addr : PAGING_PAGESZ - off;
+ 
+     if (pg_getpage_write(caller->mm, PAGING_PGN(addr), &fpn, caller) != 0)
+       break;
+     if (len == PAGING_PAGESZ)
+     {
+       if (memmap_queue(caller, SYSMEM_IO_WRITEP, fpn, 0, 0, 0, fill, NULL) != 0)
+         break;
+       continue;
+     }
+ 
+     /* A partial page keeps the rest of its content */
+     if (memmap_queue(caller, SYSMEM_IO_READP, fpn, 0, 0, 0, page, NULL) != 0 ||
+         memmap_submit(caller) != 0)
+       break;
+     memset(page + off, value, len);
+     if (memmap_queue(caller, SYSMEM_IO_WRITEP, fpn, 0, 0, 0, page, NULL) != 0)
+       break;
+   }
+   if (memmap_submit(caller) != 0)
+     addr = -1;
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+ 
+   return addr < end ? -1 : 0;
+ }
+ 
+ /*__memcpy - copy a range between region memories
+  *@caller: caller
+  *@vmaid: ID vm area the regions belong to
+  *@dstrg: destination region ID
+  *@dstoff: offset of the destination range
+  *@srcrg: source region ID
+  *@srcoff: offset of the source range
+  *@size: length of the ranges
+  *
+  * The copy goes in chunks that stay inside one source and one destination
+  * page. Each chunk is read before the destination page is faulted, so
+  * that fault may evict the source page. Overlapping ranges are copied
+  * from the end when the destination lies above the source.
+  */
+ int __memcpy(struct pcb_t *caller, int vmaid, int dstrg, int dstoff, int srcrg, int srcoff, int size)
+ {
+   BYTE src[PAGING_PAGESZ], dst[PAGING_PAGESZ];
+   int dst0, src0, back, done, len, lim, saddr, daddr, fpn;
+ 
+   /* Lock */
+   pthread_mutex_lock(&caller->mm->mm_lock);
+ 
+   if ((dst0 = rg_range(caller, vmaid, dstrg, dstoff, size)) < 0 ||
+       (src0 = rg_range(caller, vmaid, srcrg, srcoff, size)) < 0)
+   {
+     pthread_mutex_unlock(&caller->mm->mm_lock);
      return -1;
    }
+   back = dst0 > src0 && dst0 < src0 + size;
  
-   pg_setval(caller->mm, currg->rg_start + offset, value, caller);
-   pthread_mutex_unlock(&mmvm_lock);
+   for (done = 0; done < size; done += len)
+   {
+     len = size - done;
+     if (!back)
+     {
+       saddr = src0 + done;
+       daddr = dst0 + done;
+       if ((lim = PAGING_PAGESZ - PAGING_OFFST(saddr)) < len)
+         len = lim;
+       if ((lim = PAGING_PAGESZ - PAGING_OFFST(daddr)) < len)
+         len = lim;
+     }
+     else
+     {
+       saddr = src0 + size - done;
+       daddr = dst0 + size - done;
+       if ((lim = PAGING_OFFST((saddr - 1)) + 1) < len)
+         len = lim;
+       if ((lim = PAGING_OFFST((daddr - 1)) + 1) < len)
+         len = lim;
+       saddr -= len;
+       daddr -= len;
+     }
  
-   return 0;
+     /* The write of the last chunk goes in the batch of these reads */
+     if (pg_getpage(caller->mm, PAGING_PGN(saddr), &fpn, caller) != 0 ||
+         memmap_queue(caller, SYSMEM_IO_READP, fpn, 0, 0, 0, src, NULL) != 0 ||
+         pg_getpage_write(caller->mm, PAGING_PGN(daddr), &fpn, caller) != 0 ||
+         (len < PAGING_PAGESZ &&
+          memmap_queue(caller, SYSMEM_IO_READP, fpn, 0, 0, 0, dst, NULL) != 0) ||
+         memmap_submit(caller) != 0)
+       break;
+     memcpy(dst + PAGING_OFFST(daddr), src + PAGING_OFFST(saddr), len);
+     if (memmap_queue(caller, SYSMEM_IO_WRITEP, fpn, 0, 0, 0, dst, NULL) != 0)
+       break;
+   }
+   if (memmap_submit(caller) != 0)
+     done = -1;
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+ 
+   return done < size ? -1 : 0;
  }
  
- /*libwrite - PAGING-based write a region memory */
- int libwrite(
+ /*libmemset - PAGING-based fill a range of a region memory */
+ int libmemset(
      struct pcb_t *proc,   // Process executing the instruction
-     BYTE data,            // Data to be wrttien into memory
+     BYTE value,           // Fill byte
      uint32_t destination, // Index of destination register
-     uint32_t offset)
+     uint32_t offset,      // Destination address = [destination] + [offset]
+     uint32_t size)        // Number of bytes
  {
  #ifdef IODUMP
-   printf("write region=%d offset=%d value=%d\n", destination, offset, data);
+   printf("memset region=%d offset=%d value=%d size=%d\n", destination, offset, value, size);
+ #endif
+   int stat = __memset(proc, 0, destination, offset, value, size);
+ #ifdef IODUMP
  #ifdef PAGETBL_DUMP
    print_pgtbl(proc, 0, -1); // print max TBL
  #endif
    MEMPHY_dump(proc->mram);
  #endif
  
-   return __write(proc, 0, destination, offset, data);
+   return stat;
+ }
+ 
+ /*libmemcpy - PAGING-based copy a range between region memories */
+ int libmemcpy(
+     struct pcb_t *proc,   // Process executing the instruction
+     uint32_t destination, // Index of destination register
+     uint32_t dstoff,      // Destination address = [destination] + [dstoff]
+     uint32_t source,      // Index of source register
+     uint32_t srcoff,      // Source address = [source] + [srcoff]
+     uint32_t size)        // Number of bytes
+ {
+ #ifdef IODUMP
+   printf("memcpy region=%d offset=%d from region=%d offset=%d size=%d\n",
+          destination, dstoff, source, srcoff, size);
+ #endif
+   int stat = __memcpy(proc, 0, destination, dstoff, source, srcoff, size);
+ #ifdef IODUMP
+ #ifdef PAGETBL_DUMP
+   print_pgtbl(proc, 0, -1); // print max TBL
+ #endif
+   MEMPHY_dump(proc->mram);
+ #endif
+ 
+   return stat;
  }
 
  /*free_pbc_mem - collect all memphy of pcb and free its memvir
-  *@caller: caller*/
+  *@caller: caller
+  *
+  * The exit path of a finished process, the pcb itself is left to the
+  * caller.
+  */
  void free_pbc_mem(struct pcb_t* proc){
-   free_pcb_memph(proc);
+   if(proc->mm){
+    /* No reclaimer may find it any more */
+    mm_list_del(proc->mm);
+    pff_exit(proc);
+    free_pcb_memph(proc);
+   }
    if(proc->page_table) free(proc->page_table);
    if(proc->code){
     if(proc->code->text) free(proc->code->text);
@@ -573,6 +2062,7 @@
     pgn = pgn->pg_next;
     free(tmp);
    }
+   freeRBTree(proc->mm->mm_rb);
    struct vm_area_struct *vma = proc->mm->mmap;
    while(vma){
     struct vm_rg_struct *free_lst = vma->vm_freerg_list;
@@ -585,37 +2075,479 @@
     vma = vma->vm_next;
     free(tmp);
    }
+   pthread_mutex_destroy(&proc->mm->mm_lock);
    free(proc->mm);
-   //anything else to free?
+   proc->mm = NULL;
  }
 
+ /*mm_release_pages - give back every frame and swap slot of a process
+  *@caller: owner of the address space, locked by the caller
+  *
+  * Only the pages of the areas are walked, nothing outside of them is
+  * ever mapped. A huge page goes back frame by frame like base pages.
+  */
+ static void mm_release_pages(struct pcb_t *caller)
+ {
+   struct vm_area_struct *vma;
+   int pagenum, endpgn;
+   uint32_t pte;
+ 
+   shm_detach_range(caller->mm, 0, PAGING_MAX_PGN);
+   for (vma = caller->mm->mmap; vma; vma = vma->vm_next)
+   {
+     endpgn = DIV_ROUND_UP(vma->vm_end, PAGING_PAGESZ);
+     for (pagenum = PAGING_PGN(vma->vm_start); pagenum < endpgn; pagenum++)
+     {
+       pte = caller->mm->pgd[pagenum];
+       caller->mm->pgd[pagenum] = 0;
+ 
+       if (PAGING_PAGE_PRESENT(pte))
+       {
+         pg_put_frame(caller, caller->mm, pagenum, PAGING_PTE_FPN(pte));
+       }
+       else if (pte & PAGING_PTE_SWAPPED_MASK)
+       {
+         /* Back to the device the PTE swap type points to */
+         swap_put_freefp(caller, PAGING_PTE_SWPTYP(pte), PAGING_PTE_SWP(pte));
+       }
+     }
+   }
+ }
+ 
  /*free_pcb_memphy - collect all memphy of pcb
   *@caller: caller
-  *@vmaid: ID vm area to alloc memory region
-  *@incpgnum: number of page
+  *
   */
  int free_pcb_memph(struct pcb_t *caller)
  {
-   int pagenum, fpn;
+   pthread_mutex_lock(&caller->mm->mm_lock);
+   mm_release_pages(caller);
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+ 
+   return 0;
+ }
+ 
+ /*mm_count_pages - resident and swapped pages of an address space
+  *@mm: memory region, locked by the caller
+  *@zfpn: the zero frame, it is shared by every process and never counted
+  *@rss: return resident pages
+  *@nswap: return swapped pages
+  */
+ static void mm_count_pages(struct mm_struct *mm, int zfpn, uint32_t *rss, uint32_t *nswap)
+ {
+   struct vm_area_struct *vma;
+   int pgn, endpgn;
    uint32_t pte;
  
-   for (pagenum = 0; pagenum < PAGING_MAX_PGN; pagenum++)
+   *rss = *nswap = 0;
+   for (vma = mm->mmap; vma; vma = vma->vm_next)
    {
-     pte = caller->mm->pgd[pagenum];
-
-     if (PAGING_PAGE_PRESENT(pte))
+     endpgn = DIV_ROUND_UP(vma->vm_end, PAGING_PAGESZ);
+     for (pgn = PAGING_PGN(vma->vm_start); pgn < endpgn; pgn++)
      {
-       fpn = PAGING_PTE_FPN(pte);
-       MEMPHY_put_freefp(caller->mram, fpn);
+       pte = mm->pgd[pgn];
+       if (PAGING_PAGE_PRESENT(pte) && (int)PAGING_FPN(pte) != zfpn)
+         (*rss)++;
+       else if (!PAGING_PAGE_PRESENT(pte) && (pte & PAGING_PTE_SWAPPED_MASK))
+         (*nswap)++;
      }
-     else
+   }
+ }
+ 
+ /*oom_kill - kill the process holding the most memory
+  *@caller: process whose allocation found nothing left to evict, its
+  *         address space is locked by itself
+  *
+  * The badness of a process is its resident plus swapped pages, busy
+  * address spaces are skipped as reclaim does. The victim is marked the
+  * way sys_killall ends a running process and its CPU finishes it at its
+  * next time slot. Another process has its frames and swap slots given
+  * back right away, the caller cannot while it is in the middle of an
+  * access and only fails it. While an earlier victim is still on its way
+  * out nobody else is killed.
+  *
+  * Return 0 when another process was killed, 1 when the caller was and
+  * -1 when nobody was.
+  */
+ int oom_kill(struct pcb_t *caller)
+ {
+   struct mm_struct *mm, *victim = NULL, **it;
+   struct pcb_t *owner;
+   struct pgn_t *pg;
+   uint32_t rss, nswap, vrss = 0, vnswap = 0;
+   int zfpn, pid;
+ 
+   pthread_mutex_lock(&rmap_lock);
+   zfpn = caller->mram->zero_fpn;
+   pthread_mutex_unlock(&rmap_lock);
+ 
+   pthread_mutex_lock(&mmlist_lock);
+   for (mm = mm_list; mm; mm = mm->mm_next)
+   {
+     if (mm != caller->mm && pthread_mutex_trylock(&mm->mm_lock) != 0)
+       continue;
+     if (mm->oom_killed)
+     {
+       if (mm != caller->mm)
+         pthread_mutex_unlock(&mm->mm_lock);
+       pthread_mutex_unlock(&mmlist_lock);
+       return -1;
+     }
+     mm_count_pages(mm, zfpn, &rss, &nswap);
+     if (victim == NULL || rss + nswap > vrss + vnswap)
+     {
+       victim = mm;
+       vrss = rss;
+       vnswap = nswap;
+     }
+     if (mm != caller->mm)
+       pthread_mutex_unlock(&mm->mm_lock);
+   }
+ 
+   if (victim == caller->mm)
+   {
+     victim->oom_killed = 1;
+     pthread_mutex_unlock(&mmlist_lock);
+     printf("\tOOM: killed process %d, %u resident and %u swapped pages\n",
+            caller->pid, vrss, vnswap);
+     return 1;
+   }
+   if (victim == NULL || pthread_mutex_trylock(&victim->mm_lock) != 0)
+   {
+     pthread_mutex_unlock(&mmlist_lock);
+     return -1;
+   }
+ 
+   /* Off the list no reclaimer finds it, its exit path skips it too */
+   victim->oom_killed = 1;
+   for (it = &mm_list; *it != victim; it = &(*it)->mm_next)
+     ;
+   *it = victim->mm_next;
+   nr_mm--;
+   pthread_mutex_unlock(&mmlist_lock);
+ 
+   owner = victim->owner;
+   pid = owner->pid;
+   mm_release_pages(owner);
+   while ((pg = victim->fifo_pgn) != NULL)
+   {
+     victim->fifo_pgn = pg->pg_next;
+     free(pg);
+   }
+   victim->nr_resident = 0;
+   pthread_mutex_unlock(&victim->mm_lock);
+ 
+   printf("\tOOM: killed process %d, %u resident and %u swapped pages\n",
+          pid, vrss, vnswap);
+   return 0;
+ }
+ 
+ /* Larger is less important, niceness under CFS */
+ static int proc_prio(struct pcb_t *proc)
+ {
+ #ifdef CFS_SCHED
+   return (int)proc->niceness;
+ #elif defined(MLQ_SCHED)
+   return proc->prio;
+ #else
+   return proc->priority;
+ #endif
+ }
+ 
+ /*mm_select_holdback - pick the process load control holds back
+  *
+  * The lowest priority one, of those the one with the most resident
+  * and swapped pages. Busy address spaces are skipped.
+  */
+ struct pcb_t *mm_select_holdback(void)
+ {
+   struct mm_struct *mm;
+   struct pcb_t *victim = NULL;
+   uint32_t rss, nswap, size = 0;
+   int zfpn;
+ 
+   pthread_mutex_lock(&mmlist_lock);
+   for (mm = mm_list; mm; mm = mm->mm_next)
+   {
+     if (pthread_mutex_trylock(&mm->mm_lock) != 0)
+       continue;
+     if (!mm->oom_killed &&
+         (victim == NULL || proc_prio(mm->owner) >= proc_prio(victim)))
+     {
+       pthread_mutex_lock(&rmap_lock);
+       zfpn = mm->owner->mram->zero_fpn;
+       pthread_mutex_unlock(&rmap_lock);
+       mm_count_pages(mm, zfpn, &rss, &nswap);
+       if (victim == NULL || proc_prio(mm->owner) > proc_prio(victim) ||
+           rss + nswap > size)
+       {
+         victim = mm->owner;
+         size = rss + nswap;
+       }
+     }
+     pthread_mutex_unlock(&mm->mm_lock);
+   }
+   pthread_mutex_unlock(&mmlist_lock);
+ 
+   return victim;
+ }
+ 
+ /*oom_killed - tell whether the OOM killer picked a process
+  *@proc: process
+  */
+ int oom_killed(struct pcb_t *proc)
+ {
+   int killed;
+ 
+   if (proc->mm == NULL)
+     return 0;
+ 
+   pthread_mutex_lock(&proc->mm->mm_lock);
+   killed = proc->mm->oom_killed;
+   pthread_mutex_unlock(&proc->mm->mm_lock);
+ 
+   return killed;
+ }
+ 
+ /*__dup_mm - give a forked child a copy-on-write copy of the address space
+  *@caller: parent
+  *@child: child, gets a new mm
+  *
+  * Resident frames are shared and write protected in both page tables,
+  * the frame reverse map records both mappings so that swapping one of
+  * them out moves all of them. Swapped pages share their swap frame.
+  * No page content is copied.
+  */
+ int __dup_mm(struct pcb_t *caller, struct pcb_t *child)
+ {
+   struct mm_struct *mm;
+   struct vm_area_struct *vma;
+   struct vm_rg_struct *rg;
+   struct pgn_t *pgit, **pgtail;
+   struct shm_attach *at;
+   int pgn, swptyp, swpoff, segid;
+   uint32_t pte;
+ 
+   if (caller == NULL || child == NULL || caller->mm == NULL)
+     return -1;
+ 
+   mm = malloc(sizeof(struct mm_struct));
+   pthread_mutex_init(&mm->mm_lock, NULL);
+   mm->pgd = calloc(PAGING_MAX_PGN, sizeof(uint32_t));
+   memcpy(mm->symrgtbl, caller->mm->symrgtbl, sizeof(mm->symrgtbl));
+   mm->ra_win = 0;
+   mm->ra_prev_pgn = mm->ra_next_pgn = -1;
+   mm->ra_hit = mm->ra_miss = 0;
+   mm->hp_fault = mm->hp_split = 0;
+   memset(&mm->io_ring, 0, sizeof(mm->io_ring));
+ 
+   /* Lock, the child is locked as well since sharing frames makes it
+    * reachable through the reverse maps */
+   pthread_mutex_lock(&caller->mm->mm_lock);
+   pthread_mutex_lock(&mm->mm_lock);
+ 
+   /* Frames are shared page by page, huge pages are split first */
+   for (vma = caller->mm->mmap; vma; vma = vma->vm_next)
+     for (pgn = PAGING_PGN(vma->vm_start);
+          pgn < (int)DIV_ROUND_UP(vma->sbrk, PAGING_PAGESZ); pgn++)
+       if (caller->mm->pgd[pgn] & PAGING_PTE_HUGE_MASK)
+         pg_split_huge(caller->mm, pgn);
+ 
+   /* Same areas and free regions */
+   mm->mmap = NULL;
+   mm->mm_rb = NULL;
+   for (vma = caller->mm->mmap; vma; vma = vma->vm_next)
+   {
+     struct vm_area_struct *nvma = malloc(sizeof(struct vm_area_struct));
+ 
+     *nvma = *vma;
+     nvma->vm_freerg_list = NULL;
+     memset(&nvma->vm_freerg_idx, 0, sizeof(struct vm_rg_index));
+     for (rg = vma->vm_freerg_list; rg; rg = rg->rg_next)
+       freerg_insert(nvma, init_vm_rg(rg->rg_start, rg->rg_end));
+     vma_link(mm, nvma);
+   }
+ 
+   /* Same replacement order */
+   pgtail = &mm->fifo_pgn;
+   for (pgit = caller->mm->fifo_pgn; pgit; pgit = pgit->pg_next)
+   {
+     *pgtail = malloc(sizeof(struct pgn_t));
+     (*pgtail)->pgn = pgit->pgn;
+     pgtail = &(*pgtail)->pg_next;
+   }
+   *pgtail = NULL;
+   mm->nr_resident = caller->mm->nr_resident;
+ 
+   /* Only the pages below sbrk can be mapped */
+   for (vma = caller->mm->mmap; vma; vma = vma->vm_next)
+   {
+     for (pgn = PAGING_PGN(vma->vm_start);
+          pgn < (int)DIV_ROUND_UP(vma->sbrk, PAGING_PAGESZ); pgn++)
      {
-       fpn = PAGING_PTE_SWP(pte);
-       if(fpn == 0) continue; //handle uninit pte;
-       MEMPHY_put_freefp(caller->active_mswp, fpn);
+       pte = caller->mm->pgd[pgn];
+ 
+       if (PAGING_PAGE_PRESENT(pte))
+       {
+         if (PAGING_FPN(pte) != caller->mram->zero_fpn)
+           pg_share_frame(caller, PAGING_FPN(pte), caller->mm, pgn, mm, pgn);
+         CLRBIT(pte, PAGING_PTE_READAHEAD_MASK);
+ 
+         /* Shared memory stays shared, anything else is copied on write */
+         if (shm_find_page(caller->mm, pgn, NULL) == NULL)
+         {
+           SETBIT(caller->mm->pgd[pgn], PAGING_PTE_COW_MASK);
+           SETBIT(pte, PAGING_PTE_COW_MASK);
+         }
+       }
+       else if (pte & PAGING_PTE_SWAPPED_MASK)
+       {
+         swptyp = PAGING_PTE_SWPTYP(pte);
+         swpoff = PAGING_PTE_SWP(pte);
+         if (swap_dup(caller, mm, pgn, &swptyp, &swpoff) != 0)
+           pte = 0; // Out of swap, the child sees a hole
+         else
+           pte_set_swap(&pte, swptyp, swpoff);
+       }
+       mm->pgd[pgn] = pte;
      }
    }
  
+   /* The child is attached to the same segments */
+   pthread_mutex_lock(&shm_lock);
+   for (segid = 0; segid < nr_shm; segid++)
+     for (at = shm_table[segid].attach; at; at = at->at_next)
+       if (at->mm == caller->mm)
+         shm_attach_add(&shm_table[segid], mm, at->pgn);
+   pthread_mutex_unlock(&shm_lock);
+ 
+   child->mm = mm;
+   mm_list_add(mm, child);
+   pthread_mutex_unlock(&mm->mm_lock);
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+ 
+   return 0;
+ }
+ 
+ /*__shmget - find or create a shared memory segment
+  *@caller: caller
+  *@key: name of the segment
+  *@size: size of the segment
+  *
+  * Return the segment ID. The pages get frames on first touch through
+  * any attached process.
+  */
+ int __shmget(struct pcb_t *caller, int key, int size)
+ {
+   struct shm_struct *seg;
+   int segid, pgit;
+ 
+   if (caller == NULL || size <= 0)
+     return -1;
+ 
+   /* Lock */
+   pthread_mutex_lock(&shm_lock);
+ 
+   for (segid = 0; segid < nr_shm; segid++)
+   {
+     if (shm_table[segid].key != key)
+       continue;
+     pthread_mutex_unlock(&shm_lock);
+     return size <= shm_table[segid].npages * PAGING_PAGESZ ? segid : -1;
+   }
+ 
+   if (nr_shm == SHM_MAX_SEG)
+   {
+     pthread_mutex_unlock(&shm_lock);
+     return -1; // Segment table is full
+   }
+ 
+   seg = &shm_table[nr_shm];
+   seg->key = key;
+   seg->npages = DIV_ROUND_UP(size, PAGING_PAGESZ);
+   seg->attach = NULL;
+   seg->mm = calloc(1, sizeof(struct mm_struct));
+   pthread_mutex_init(&seg->mm->mm_lock, NULL);
+   seg->mm->pgd = calloc(seg->npages, sizeof(uint32_t));
+   for (pgit = 0; pgit < seg->npages; pgit++)
+     pte_set_reserve(&seg->mm->pgd[pgit]);
+   seg->mm->ra_prev_pgn = seg->mm->ra_next_pgn = -1;
+ 
+   segid = nr_shm++;
+   pthread_mutex_unlock(&shm_lock);
+ 
+   return segid;
+ }
+ 
+ /*__shmat - attach a shared memory segment
+  *@caller: caller
+  *@key: name of the segment
+  *@rgid: memory region ID the segment is mapped at
+  *
+  * The segment gets an area of its own above VM_MMAP_BASE, freeing the
+  * region unmaps it.
+  */
+ int __shmat(struct pcb_t *caller, int key, int rgid)
+ {
+   struct vm_area_struct *vma;
+   struct shm_struct *seg = NULL;
+   int segid;
+ 
+   if (caller == NULL || rgid < 0 || rgid > PAGING_MAX_SYMTBL_SZ)
+     return -1;
+ 
+   /* Lock */
+   pthread_mutex_lock(&caller->mm->mm_lock);
+   pthread_mutex_lock(&shm_lock);
+ 
+   for (segid = 0; segid < nr_shm; segid++)
+     if (shm_table[segid].key == key)
+       seg = &shm_table[segid];
+ 
+   /* Fresh reserved pages, the faults map the segment into them */
+   if (seg == NULL || (vma = vm_map_area(caller, seg->npages * PAGING_PAGESZ)) == NULL)
+   {
+     pthread_mutex_unlock(&shm_lock);
+     pthread_mutex_unlock(&caller->mm->mm_lock);
+     return -1;
+   }
+ 
+   caller->mm->symrgtbl[rgid].rg_start = vma->vm_start;
+   caller->mm->symrgtbl[rgid].rg_end = vma->vm_end;
+   shm_attach_add(seg, caller->mm, PAGING_PGN(vma->vm_start));
+ 
+   pthread_mutex_unlock(&shm_lock);
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+ 
+   return 0;
+ }
+ 
+ /*__getrusage - snapshot the resource usage of a process
+  *@caller: caller
+  *@ru: return usage, the counters plus the pages it holds now
+  *
+  * The zero frame is shared by every process and never counted.
+  */
+ int __getrusage(struct pcb_t *caller, struct rusage_struct *ru)
+ {
+   int zfpn;
+ 
+   if (caller == NULL || ru == NULL)
+     return -1;
+ 
+   *ru = caller->ru;
+   ru->ru_rss = ru->ru_nswap = 0;
+   if (caller->mm == NULL)
+     return 0;
+ 
+   pthread_mutex_lock(&caller->mm->mm_lock);
+   pthread_mutex_lock(&rmap_lock);
+   zfpn = caller->mram->zero_fpn;
+   pthread_mutex_unlock(&rmap_lock);
+ 
+   mm_count_pages(caller->mm, zfpn, &ru->ru_rss, &ru->ru_nswap);
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+ 
    return 0;
  }
  
@@ -644,6 +2576,7 @@
    }
  
    *retpgn = pg->pgn;
+   mm->nr_resident -= HPAGE_WEIGHT(mm->pgd[pg->pgn]);
    if (prev) {
      prev->pg_next = NULL;
    } else {
@@ -677,32 +2610,21 @@
     int inc_sz = PAGING_PAGE_ALIGNSZ(size);
 
    /* TODO Traverse on list of free vm region to find a fit space */
-   while (rgit) {
-     rg_size = rgit->rg_end - rgit->rg_start;
-     if (rg_size >= inc_sz) {
-       newrg->rg_start = rgit->rg_start;
-       newrg->rg_end = rgit->rg_start + inc_sz;
-       break;
-     }
-     rgit = rgit->rg_next;
-   }
- 
+   rgit = freerg_find_fit(cur_vma, inc_sz);
    if (!rgit)
      return -1; // No fit region found
+   rg_size = rgit->rg_end - rgit->rg_start;
+   newrg->rg_start = rgit->rg_start;
+   newrg->rg_end = rgit->rg_start + inc_sz;
  
    /* Free the region in vm_freerg_list */
-   delist_vm_freerg_list(caller->mm, rgit);
+   freerg_remove(cur_vma, rgit);
    *num_mapped_pages = inc_sz / PAGING_PAGESZ;
-   
  
-   if (rg_size > inc_sz) { // allocate more than need
-     struct vm_rg_struct *newrg2 = malloc(sizeof(struct vm_rg_struct));
-     newrg2->rg_start = newrg->rg_end;
-     newrg2->rg_end = rgit->rg_end;
-     newrg2->rg_next = NULL;
- 
-     /* Enlist the new region */
-     enlist_vm_freerg_list(caller->mm, newrg2);
+   if (rg_size > inc_sz) { // allocate more than need, the rest stays free
+     rgit->rg_start = newrg->rg_end;
+     freerg_insert(cur_vma, rgit);
+     return 0;
    }
    free(rgit);
    return 0;
@@ -23,5 +23,9 @@ int libsyscall (struct pcb_t *caller,
    regs.a2 = a2;
    regs.a3 = a3;
 
+   /* Fast path, straight to the handler while nothing is counted */
+   if (!sys_call_stat_on && syscall_idx < (uint32_t)syscall_table_size)
+      return sys_call_handlers[syscall_idx](caller, &regs);
+
    return syscall(caller, syscall_idx, &regs);
 }
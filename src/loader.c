@@ -3,8 +3,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 static uint32_t avail_pid = 1;
+static pthread_mutex_t pid_lock = PTHREAD_MUTEX_INITIALIZER;
 
 #define OPT_CALC	"calc"
 #define OPT_ALLOC	"alloc"
@@ -12,6 +14,20 @@ static uint32_t avail_pid = 1;
 #define OPT_READ	"read"
 #define OPT_WRITE	"write"
 #define OPT_SYSCALL	"syscall"
+#define OPT_MEMSET	"memset"
+#define OPT_MEMCPY	"memcpy"
+
+/* Bytes moved by a sized read/write mnemonic, 0 when the suffix is not a width */
+static uint32_t word_width(const char * bits) {
+	if (!strcmp(bits, "16")) {
+		return 2;
+	}else if (!strcmp(bits, "32")) {
+		return 4;
+	}else if (!strcmp(bits, "64")) {
+		return 8;
+	}
+	return 0;
+}
 
 static enum ins_opcode_t get_opcode(char * opt) {
 	if (!strcmp(opt, OPT_CALC)) {
@@ -26,17 +42,37 @@ static enum ins_opcode_t get_opcode(char * opt) {
 		return WRITE;
 	}else if (!strcmp(opt, OPT_SYSCALL)) {
 		return SYSCALL;
+	}else if (!strcmp(opt, OPT_MEMSET)) {
+		return MEMSET;
+	}else if (!strcmp(opt, OPT_MEMCPY)) {
+		return MEMCPY;
+	}else if (!strncmp(opt, OPT_READ, strlen(OPT_READ)) &&
+		  word_width(opt + strlen(OPT_READ))) {
+		return READW;
+	}else if (!strncmp(opt, OPT_WRITE, strlen(OPT_WRITE)) &&
+		  word_width(opt + strlen(OPT_WRITE))) {
+		return WRITEW;
 	}else{
 		printf("get_opcode return Opcode: %s\n", opt);
 		exit(1);
 	}
 }
 
+/* Hand out the next PID, the loader and fork share the counter */
+uint32_t alloc_pid(void) {
+	uint32_t pid;
+
+	pthread_mutex_lock(&pid_lock);
+	pid = avail_pid++;
+	pthread_mutex_unlock(&pid_lock);
+
+	return pid;
+}
+
 struct pcb_t * load(const char * path) {
 	/* Create new PCB for the new process */
 	struct pcb_t * proc = (struct pcb_t * )malloc(sizeof(struct pcb_t));
-	proc->pid = avail_pid;
-	avail_pid++;
+	proc->pid = alloc_pid();
 	proc->page_table =
 		(struct page_table_t*)malloc(sizeof(struct page_table_t));
 	proc->bp = PAGE_SIZE;
@@ -57,6 +93,7 @@ struct pcb_t * load(const char * path) {
 	);
 	uint32_t i = 0;
 	char buf[200];
+	unsigned long word;
 	for (i = 0; i < proc->code->size; i++) {
 		fscanf(file, "%s", opcode);
 		proc->code->text[i].opcode = get_opcode(opcode);
@@ -64,11 +101,13 @@ struct pcb_t * load(const char * path) {
 		case CALC:
 			break;
 		case ALLOC:
-			fscanf(
-				file,
-				"%u %u\n",
-				&proc->code->text[i].arg_0,
-				&proc->code->text[i].arg_1
+			/* Optional third argument: populate the region now */
+			fgets(buf, sizeof(buf), file);
+			proc->code->text[i].arg_2 = 0;
+			sscanf(buf, "%u %u %u",
+			           &proc->code->text[i].arg_0,
+			           &proc->code->text[i].arg_1,
+			           &proc->code->text[i].arg_2
 			);
 			break;
 		case FREE:
@@ -93,6 +132,53 @@ struct pcb_t * load(const char * path) {
 			           &proc->code->text[i].arg_3
 			);
 			break;
+		case MEMSET:
+			/* memset <value> <region> <offset> <size> */
+			fscanf(
+				file,
+				"%u %u %u %u\n",
+				&proc->code->text[i].arg_0,
+				&proc->code->text[i].arg_1,
+				&proc->code->text[i].arg_2,
+				&proc->code->text[i].arg_3
+			);
+			break;
+		case MEMCPY:
+			/* memcpy <dst region> <dst offset> <src region> <src offset> <size> */
+			fscanf(
+				file,
+				"%u %u %u %u %u\n",
+				&proc->code->text[i].arg_0,
+				&proc->code->text[i].arg_1,
+				&proc->code->text[i].arg_2,
+				&proc->code->text[i].arg_3,
+				&proc->code->text[i].arg_4
+			);
+			break;
+		case READW:
+			/* readN <region> <offset> <destination> */
+			fscanf(
+				file,
+				"%u %u %u\n",
+				&proc->code->text[i].arg_0,
+				&proc->code->text[i].arg_1,
+				&proc->code->text[i].arg_2
+			);
+			proc->code->text[i].arg_3 = word_width(opcode + strlen(OPT_READ));
+			break;
+		case WRITEW:
+			/* writeN <value> <region> <offset> */
+			fscanf(
+				file,
+				"%lu %u %u\n",
+				&word,
+				&proc->code->text[i].arg_1,
+				&proc->code->text[i].arg_2
+			);
+			proc->code->text[i].arg_0 = (uint32_t)word;
+			proc->code->text[i].arg_3 = word_width(opcode + strlen(OPT_WRITE));
+			proc->code->text[i].arg_4 = (uint32_t)(word >> 32);
+			break;
 		default:
 			printf("Opcode: %s\n", opcode);
 			exit(1);
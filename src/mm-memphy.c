@@ -9,6 +9,37 @@
  #include <stdio.h>
  #include <stdlib.h>
  #include <string.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/mman.h>
+ #include <pthread.h>
+ #if defined(__AVX2__) || defined(__SSE2__)
+ #include <immintrin.h>
+ #endif
+ 
+ /* Device time of the accesses made by this thread, the CPU running a
+  * process collects it after each instruction */
+ static __thread unsigned long memphy_ticks;
+ 
+ /*
+  *  memphy_charge - account the device time of an access
+  *  @mp: memphy struct
+  *  @addr: address the access starts at
+  *  @len: bytes transferred
+  *
+  *  Sequential devices add the seek from the cursor to @addr, so they charge
+  *  under mp->lock before the cursor moves.
+  */
+ static void memphy_charge(struct memphy_struct *mp, int addr, int len)
+ {
+    unsigned long cost = mp->lat_access;
+ 
+    if (len >= PAGING_PAGESZ)
+       cost += mp->lat_page;
+    if (!mp->rdmflg)
+       cost += (unsigned long)mp->lat_seek * (abs(addr - mp->cursor) / PAGING_PAGESZ);
+    memphy_ticks += cost;
+ }
  
  /*
   *  MEMPHY_mv_csr - move MEMPHY cursor
@@ -41,11 +72,14 @@
     if (mp == NULL)
        return -1;
  
-    if (!mp->rdmflg)
+    if (mp->rdmflg)
        return -1; /* Not compatible mode for sequential read */
  
+    pthread_mutex_lock(&mp->lock);
+    memphy_charge(mp, addr, 1);
     MEMPHY_mv_csr(mp, addr);
     *value = (BYTE)mp->storage[addr];
+    pthread_mutex_unlock(&mp->lock);
  
     return 0;
  }
@@ -62,7 +96,10 @@
        return -1;
  
     if (mp->rdmflg)
+    {
+       memphy_charge(mp, addr, 1);
        *value = mp->storage[addr];
+    }
     else /* Sequential access device */
        return MEMPHY_seq_read(mp, addr, value);
  
@@ -81,11 +118,14 @@
     if (mp == NULL)
        return -1;
  
-    if (!mp->rdmflg)
-       return -1; /* Not compatible mode for sequential read */
+    if (mp->rdmflg)
+       return -1; /* Not compatible mode for sequential write */
  
+    pthread_mutex_lock(&mp->lock);
+    memphy_charge(mp, addr, 1);
     MEMPHY_mv_csr(mp, addr);
     mp->storage[addr] = value;
+    pthread_mutex_unlock(&mp->lock);
  
     return 0;
  }
@@ -102,89 +142,540 @@
        return -1;
  
     if (mp->rdmflg)
+    {
+       memphy_charge(mp, addr, 1);
        mp->storage[addr] = data;
+    }
     else /* Sequential access device */
        return MEMPHY_seq_write(mp, addr, data);
  
     return 0;
  }
  
+ /*
+  *  MEMPHY_read_word - read up to 8 bytes of MEMPHY device in one access
+  *  @mp: memphy struct
+  *  @addr: address
+  *  @len: number of bytes
+  *  @value: obtained value, little endian
+  */
+ int MEMPHY_read_word(struct memphy_struct *mp, int addr, int len, uint64_t *value)
+ {
+    int i;
+ 
+    if (mp == NULL || value == NULL || len < 1 || len > 8 || addr < 0 || addr + len > mp->maxsz)
+       return -1;
+ 
+    if (!mp->rdmflg)
+       pthread_mutex_lock(&mp->lock);
+    memphy_charge(mp, addr, len);
+    if (!mp->rdmflg)
+       MEMPHY_mv_csr(mp, addr);
+    *value = 0;
+    for (i = 0; i < len; i++)
+       *value |= (uint64_t)(unsigned char)mp->storage[addr + i] << (8 * i);
+    if (!mp->rdmflg)
+    {
+       mp->cursor = (addr + len) % mp->maxsz;
+       pthread_mutex_unlock(&mp->lock);
+    }
+ 
+    return 0;
+ }
+ 
+ /*
+  *  MEMPHY_write_word - write up to 8 bytes of MEMPHY device in one access
+  *  @mp: memphy struct
+  *  @addr: address
+  *  @len: number of bytes
+  *  @value: written value, little endian
+  */
+ int MEMPHY_write_word(struct memphy_struct *mp, int addr, int len, uint64_t value)
+ {
+    int i;
+ 
+    if (mp == NULL || len < 1 || len > 8 || addr < 0 || addr + len > mp->maxsz)
+       return -1;
+ 
+    if (!mp->rdmflg)
+       pthread_mutex_lock(&mp->lock);
+    memphy_charge(mp, addr, len);
+    if (!mp->rdmflg)
+       MEMPHY_mv_csr(mp, addr);
+    for (i = 0; i < len; i++)
+       mp->storage[addr + i] = (BYTE)(value >> (8 * i));
+    if (!mp->rdmflg)
+    {
+       mp->cursor = (addr + len) % mp->maxsz;
+       pthread_mutex_unlock(&mp->lock);
+    }
+ 
+    return 0;
+ }
+ 
+ /*
+  *  MEMPHY_read_page - read a whole frame of MEMPHY device
+  *  @mp: memphy struct
+  *  @fpn: frame page number
+  *  @buf: destination buffer of PAGING_PAGESZ bytes
+  *
+  *  Sequential devices seek once to the frame then stream the page. Random
+  *  access devices take no lock, the owner of a frame is the only one to
+  *  touch its content.
+  */
+ int MEMPHY_read_page(struct memphy_struct *mp, int fpn, BYTE *buf)
+ {
+    int addr;
+ 
+    if (mp == NULL || buf == NULL || fpn < 0 || fpn >= mp->maxfp)
+       return -1;
+ 
+    addr = fpn * PAGING_PAGESZ;
+    if (!mp->rdmflg)
+    {
+       pthread_mutex_lock(&mp->lock);
+       memphy_charge(mp, addr, PAGING_PAGESZ);
+       MEMPHY_mv_csr(mp, addr);
+       mp->cursor = (addr + PAGING_PAGESZ) % mp->maxsz;
+       memcpy(buf, &mp->storage[addr], PAGING_PAGESZ);
+       pthread_mutex_unlock(&mp->lock);
+       return 0;
+    }
+    memphy_charge(mp, addr, PAGING_PAGESZ);
+    memcpy(buf, &mp->storage[addr], PAGING_PAGESZ);
+ 
+    return 0;
+ }
+ 
+ /*
+  *  MEMPHY_write_page - write a whole frame of MEMPHY device
+  *  @mp: memphy struct
+  *  @fpn: frame page number
+  *  @buf: source buffer of PAGING_PAGESZ bytes
+  */
+ int MEMPHY_write_page(struct memphy_struct *mp, int fpn, const BYTE *buf)
+ {
+    int addr;
+ 
+    if (mp == NULL || buf == NULL || fpn < 0 || fpn >= mp->maxfp)
+       return -1;
+ 
+    addr = fpn * PAGING_PAGESZ;
+    if (!mp->rdmflg)
+    {
+       pthread_mutex_lock(&mp->lock);
+       memphy_charge(mp, addr, PAGING_PAGESZ);
+       MEMPHY_mv_csr(mp, addr);
+       mp->cursor = (addr + PAGING_PAGESZ) % mp->maxsz;
+       memcpy(&mp->storage[addr], buf, PAGING_PAGESZ);
+       pthread_mutex_unlock(&mp->lock);
+       return 0;
+    }
+    memphy_charge(mp, addr, PAGING_PAGESZ);
+    memcpy(&mp->storage[addr], buf, PAGING_PAGESZ);
+ 
+    return 0;
+ }
+ 
+ /*
+  *  buddy_enlist - push a free block to the free area of its order
+  *  @mp: memphy struct
+  *  @fpn: head frame of the block
+  *  @order: block order
+  */
+ static void buddy_enlist(struct memphy_struct *mp, int fpn, int order)
+ {
+    struct frame_struct *fr = &mp->frames[fpn];
+    int head = mp->free_area[order];
+ 
+    fr->flags |= FRAME_FREE;
+    fr->order = order;
+    fr->bd_prev = -1;
+    fr->bd_next = head;
+    if (head != -1)
+       mp->frames[head].bd_prev = fpn;
+    mp->free_area[order] = fpn;
+ 
+    mp->nr_free[order]++;
+    mp->free_fpnum += 1 << order;
+ }
+ 
+ /*
+  *  buddy_delist - unlink a free block from the free area of its order
+  *  @mp: memphy struct
+  *  @fpn: head frame of the block
+  */
+ static void buddy_delist(struct memphy_struct *mp, int fpn)
+ {
+    struct frame_struct *fr = &mp->frames[fpn];
+    int order = fr->order;
+ 
+    if (fr->bd_prev != -1)
+       mp->frames[fr->bd_prev].bd_next = fr->bd_next;
+    else
+       mp->free_area[order] = fr->bd_next;
+    if (fr->bd_next != -1)
+       mp->frames[fr->bd_next].bd_prev = fr->bd_prev;
+ 
+    fr->flags &= ~FRAME_FREE;
+    mp->nr_free[order]--;
+    mp->free_fpnum -= 1 << order;
+ }
+ 
+ /*
+  *  memphy_mark_used - update the used-frame bitmap for a block
+  *  @mp: memphy struct
+  *  @fpn: head frame of the block
+  *  @order: block order
+  *  @used: allocated or given back
+  */
+ static void memphy_mark_used(struct memphy_struct *mp, int fpn, int order, int used)
+ {
+    int end = fpn + (1 << order);
+ 
+    for (; fpn < end; fpn++)
+    {
+       if (used)
+          mp->used_map[BIT_WORD(fpn)] |= BIT_MASK(fpn);
+       else
+          mp->used_map[BIT_WORD(fpn)] &= ~BIT_MASK(fpn);
+    }
+ }
+ 
+ /*
+  *  buddy_carve_order - order of the aligned block starting at an untouched frame
+  *  @mp: memphy struct
+  *  @fpn: first untouched frame
+  */
+ static int buddy_carve_order(struct memphy_struct *mp, int fpn)
+ {
+    int order = MEMPHY_MAX_ORDER - 1;
+ 
+    while (order > 0 && ((fpn & ((1 << order) - 1)) || fpn + (1 << order) > mp->maxfp))
+       order--;
+ 
+    return order;
+ }
+ 
  /*
   *  MEMPHY_format-format MEMPHY device
   *  @mp: memphy struct
+  *
+  *  Frames from lazy_fpn upwards are free and have never been touched, the
+  *  allocator carves them into blocks on demand. Formatting is O(1) and the
+  *  per-frame table only materializes for frames that get used.
   */
  int MEMPHY_format(struct memphy_struct *mp, int pagesz)
  {
     /* This setting come with fixed constant PAGESZ */
     int numfp = mp->maxsz / pagesz;
-    struct framephy_struct *newfst, *fst;
-    int iter = 0;
+    int order;
+ 
+    for (order = 0; order < MEMPHY_MAX_ORDER; order++)
+    {
+       mp->free_area[order] = -1;
+       mp->nr_free[order] = 0;
+    }
+    mp->nr_alloc = 0;
+    mp->maxfp = (numfp > 0) ? numfp : 0;
+    mp->free_fpnum = mp->maxfp;
+    mp->lazy_fpn = 0;
+    mp->zero_fpn = -1;
+    mp->frames = NULL;
+    mp->used_map = NULL;
+    mp->lat_access = mp->lat_page = mp->lat_seek = 0;
+    pthread_mutex_init(&mp->lock, NULL);
  
     if (numfp <= 0)
        return -1;
  
-    /* Init head of free framephy list */
-    fst = malloc(sizeof(struct framephy_struct));
-    fst->fpn = iter;
-    mp->free_fp_list = fst;
+    mp->frames = calloc(numfp, sizeof(struct frame_struct));
+    mp->used_map = calloc(DIV_ROUND_UP(numfp, BITS_PER_LONG), sizeof(unsigned long));
  
-    /* We have list with first element, fill in the rest num-1 element member*/
-    for (iter = 1; iter < numfp; iter++)
+    return 0;
+ }
+ 
+ /*
+  *  MEMPHY_get_freefp_order - allocate a block of 2^order contiguous frames
+  *  @mp: memphy struct
+  *  @order: block order
+  *  @retfpn: head frame of the allocated block
+  */
+ int MEMPHY_get_freefp_order(struct memphy_struct *mp, int order, int *retfpn)
+ {
+    int cur, fpn;
+ 
+    if (mp == NULL || order < 0 || order >= MEMPHY_MAX_ORDER)
+       return -1;
+ 
+    pthread_mutex_lock(&mp->lock);
+ 
+    /* Smallest free block that satisfies the request, carving untouched
+     * frames only when the recycled ones are not enough */
+    for (;;)
     {
-       newfst = malloc(sizeof(struct framephy_struct));
-       newfst->fpn = iter;
-       newfst->fp_next = NULL;
-       fst->fp_next = newfst;
-       fst = newfst;
+       for (cur = order; cur < MEMPHY_MAX_ORDER; cur++)
+          if (mp->free_area[cur] != -1)
+             break;
+ 
+       if (cur < MEMPHY_MAX_ORDER || mp->lazy_fpn >= mp->maxfp)
+          break;
+ 
+       cur = buddy_carve_order(mp, mp->lazy_fpn);
+       mp->free_fpnum -= 1 << cur;
+       buddy_enlist(mp, mp->lazy_fpn, cur);
+       mp->lazy_fpn += 1 << cur;
     }
  
+    if (cur == MEMPHY_MAX_ORDER)
+    {
+       pthread_mutex_unlock(&mp->lock);
+       return -1;
+    }
+ 
+    fpn = mp->free_area[cur];
+    buddy_delist(mp, fpn);
+ 
+    /* Split down, giving the upper halves back */
+    while (cur > order)
+    {
+       cur--;
+       buddy_enlist(mp, fpn + (1 << cur), cur);
+    }
+ 
+    mp->nr_alloc++;
+    memphy_mark_used(mp, fpn, order, 1);
+    *retfpn = fpn;
+ 
+    pthread_mutex_unlock(&mp->lock);
     return 0;
  }
  
- int MEMPHY_get_freefp(struct memphy_struct *mp, int *retfpn)
+ /*
+  *  MEMPHY_put_freefp_order - release a block and coalesce with its buddies
+  *  @mp: memphy struct
+  *  @fpn: head frame of the block
+  *  @order: block order
+  */
+ int MEMPHY_put_freefp_order(struct memphy_struct *mp, int fpn, int order)
  {
-    struct framephy_struct *fp = mp->free_fp_list;
+    int buddy;
  
-    if (fp == NULL)
+    if (mp == NULL || fpn < 0 || fpn >= mp->maxfp || order < 0 || order >= MEMPHY_MAX_ORDER)
        return -1;
  
-    *retfpn = fp->fpn;
-    mp->free_fp_list = fp->fp_next;
+    pthread_mutex_lock(&mp->lock);
+    memphy_mark_used(mp, fpn, order, 0);
+    while (order < MEMPHY_MAX_ORDER - 1)
+    {
+       buddy = fpn ^ (1 << order);
+       if (buddy >= mp->lazy_fpn ||
+           !(mp->frames[buddy].flags & FRAME_FREE) ||
+           mp->frames[buddy].order != order)
+          break;
+ 
+       buddy_delist(mp, buddy);
+       if (buddy < fpn)
+          fpn = buddy;
+       order++;
+    }
  
-    /* MEMPHY is iteratively used up until its exhausted
-     * No garbage collector acting then it not been released
-     */
-    free(fp);
+    buddy_enlist(mp, fpn, order);
+    pthread_mutex_unlock(&mp->lock);
  
     return 0;
  }
  
+ int MEMPHY_get_freefp(struct memphy_struct *mp, int *retfpn)
+ {
+    return MEMPHY_get_freefp_order(mp, 0, retfpn);
+ }
+ 
+ /*
+  *  MEMPHY_frag_index - unusable free space index for a block order
+  *  @mp: memphy struct
+  *  @order: requested order
+  *
+  *  Return permille of free frames that lie in blocks smaller than 2^order
+  */
+ static int __frag_index(struct memphy_struct *mp, int order)
+ {
+    int cur, fpn, usable = 0;
+ 
+    if (mp->free_fpnum == 0)
+       return 0;
+ 
+    for (cur = order; cur < MEMPHY_MAX_ORDER; cur++)
+       usable += mp->nr_free[cur] << cur;
+ 
+    /* Untouched frames count as the blocks they would be carved into */
+    for (fpn = mp->lazy_fpn; fpn < mp->maxfp; fpn += 1 << cur)
+    {
+       cur = buddy_carve_order(mp, fpn);
+       if (cur >= order)
+          usable += 1 << cur;
+    }
+ 
+    return (int)((long)(mp->free_fpnum - usable) * 1000 / mp->free_fpnum);
+ }
+ 
+ int MEMPHY_frag_index(struct memphy_struct *mp, int order)
+ {
+    int frag;
+ 
+    if (mp == NULL)
+       return 0;
+ 
+    pthread_mutex_lock(&mp->lock);
+    frag = __frag_index(mp, order);
+    pthread_mutex_unlock(&mp->lock);
+ 
+    return frag;
+ }
+ 
+ /*
+  *  MEMPHY_buddyinfo - print free blocks per order and fragmentation
+  *  @mp: memphy struct
+  */
+ int MEMPHY_buddyinfo(struct memphy_struct *mp)
+ {
+    int order;
+ 
+    if (mp == NULL)
+       return -1;
+ 
+    pthread_mutex_lock(&mp->lock);
+    printf("buddyinfo: free %d/%d frames, %d untouched\n",
+           mp->free_fpnum, mp->maxfp, mp->maxfp - mp->lazy_fpn);
+    printf("order:");
+    for (order = 0; order < MEMPHY_MAX_ORDER; order++)
+       printf(" %5d", order);
+    printf("\nfree: ");
+    for (order = 0; order < MEMPHY_MAX_ORDER; order++)
+       printf(" %5d", mp->nr_free[order]);
+    printf("\nfrag: ");
+    for (order = 0; order < MEMPHY_MAX_ORDER; order++)
+       printf(" %5.3f", __frag_index(mp, order) / 1000.0);
+    printf("\n");
+    pthread_mutex_unlock(&mp->lock);
+ 
+    return 0;
+ }
+ 
+ /*
+  *  memphy_next_nonzero - find the next non-zero byte
+  *  @buf: storage
+  *  @from: first offset to look at
+  *  @to: end of the range
+  *
+  *  Compares 32 or 16 bytes at a time when the CPU has the vector units,
+  *  return @to when the rest of the range is zero.
+  */
+ static int memphy_next_nonzero(const BYTE *buf, int from, int to)
+ {
+ #if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+ 
+    for (; from + 32 <= to; from += 32)
+    {
+       __m256i v = _mm256_loadu_si256((const __m256i *)(buf + from));
+       unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+ 
+       if (mask)
+          return from + __builtin_ctz(mask);
+    }
+ #elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+ 
+    for (; from + 16 <= to; from += 16)
+    {
+       __m128i v = _mm_loadu_si128((const __m128i *)(buf + from));
+       unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) ^ 0xFFFF;
+ 
+       if (mask)
+          return from + __builtin_ctz(mask);
+    }
+ #endif
+    while (from < to && buf[from] == 0)
+       from++;
+ 
+    return from;
+ }
+ 
+ /*
+  *  MEMPHY_dump - print the non-zero bytes of MEMPHY device
+  *  @mp: memphy struct
+  *
+  *  Only allocated frames are scanned, a whole bitmap word of free frames
+  *  is skipped at once.
+  */
  int MEMPHY_dump(struct memphy_struct *mp) {
+    int fpn, addr, end;
+ 
     printf("===== PHYSICAL MEMORY DUMP =====\n");
-    for (int i = 0; i < mp->maxsz; ++i)
+    pthread_mutex_lock(&mp->lock);
+    for (fpn = 0; fpn < mp->maxfp; fpn++)
     {
-       if (mp->storage[i] != 0)
+       if (!(mp->used_map[BIT_WORD(fpn)] & BIT_MASK(fpn)))
        {
-          printf("BYTE %08d: %d\n", i, mp->storage[i]);
+          if (mp->used_map[BIT_WORD(fpn)] == 0)
+             fpn |= BITS_PER_LONG - 1;
+          continue;
        }
+ 
+       end = (fpn + 1) * PAGING_PAGESZ;
+       for (addr = memphy_next_nonzero(mp->storage, fpn * PAGING_PAGESZ, end); addr < end;
+            addr = memphy_next_nonzero(mp->storage, addr + 1, end))
+          printf("BYTE %08d: %d\n", addr, mp->storage[addr]);
     }
+    pthread_mutex_unlock(&mp->lock);
     printf("===== PHYSICAL MEMORY END-DUMP =====\n");
     return 0;
  }
  
  int MEMPHY_put_freefp(struct memphy_struct *mp, int fpn)
  {
-    struct framephy_struct *fp = mp->free_fp_list;
-    struct framephy_struct *newnode = malloc(sizeof(struct framephy_struct));
+    return MEMPHY_put_freefp_order(mp, fpn, 0);
+ }
+ 
+ /*
+  *  MEMPHY_set_latency - attach a cost model to a MEMPHY device
+  *  @mp: memphy struct
+  *  @access: ticks of every access
+  *  @page: extra ticks of a whole frame transfer
+  *  @seek: ticks per page the cursor travels, negative keeps random access
+  *
+  *  A seek cost turns the device into a sequential one, its accesses then
+  *  go through the cursor.
+  */
+ int MEMPHY_set_latency(struct memphy_struct *mp, int access, int page, int seek)
+ {
+    if (mp == NULL || access < 0 || page < 0)
+       return -1;
  
-    /* Create new node with value fpn */
-    newnode->fpn = fpn;
-    newnode->fp_next = fp;
-    mp->free_fp_list = newnode;
+    mp->lat_access = access;
+    mp->lat_page = page;
+    if (seek >= 0)
+    {
+       mp->lat_seek = seek;
+       mp->rdmflg = 0;
+       mp->cursor = 0;
+    }
  
     return 0;
  }
  
+ /*
+  *  MEMPHY_take_ticks - collect the device time charged to this thread
+  */
+ unsigned long MEMPHY_take_ticks(void)
+ {
+    unsigned long ticks = memphy_ticks;
+ 
+    memphy_ticks = 0;
+    return ticks;
+ }
+ 
  /*
   *  Init MEMPHY struct
   */
@@ -204,5 +695,59 @@
     return 0;
  }
  
+ /*
+  *  init_memphy_mmap - Init MEMPHY struct backed by a memory mapping
+  *  @mp: memphy struct
+  *  @max_size: device size
+  *  @randomflg: random access device
+  *  @path: sparse host file, NULL for anonymous memory
+  *  @persist: keep the file content and the file itself across runs
+  *
+  *  Nothing is reserved or zeroed up front, host pages only materialize
+  *  when the device writes them.
+  */
+ int init_memphy_mmap(struct memphy_struct *mp, int max_size, int randomflg,
+                      const char *path, int persist)
+ {
+    void *storage = MAP_FAILED;
+    int fd;
+ 
+    if (max_size <= 0)
+       return init_memphy(mp, max_size, randomflg);
+ 
+    if (path == NULL)
+    {
+       storage = mmap(NULL, max_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    else if ((fd = open(path, O_RDWR | O_CREAT, 0644)) >= 0)
+    {
+       /* A fresh run starts from a hole-only file of the device size */
+       if ((persist || ftruncate(fd, 0) == 0) && ftruncate(fd, max_size) == 0)
+          storage = mmap(NULL, max_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+       close(fd);
+       if (!persist)
+          unlink(path);
+    }
+ 
+    if (storage == MAP_FAILED)
+    {
+       printf("init_memphy_mmap: cannot map %s, fall back to heap storage\n",
+              path ? path : "anonymous memory");
+       return init_memphy(mp, max_size, randomflg);
+    }
+ 
+    mp->storage = (BYTE *)storage;
+    mp->maxsz = max_size;
+ 
+    MEMPHY_format(mp, PAGING_PAGESZ);
+ 
+    mp->rdmflg = (randomflg != 0) ? 1 : 0;
+ 
+    if (!mp->rdmflg) /* Not Ramdom acess device, then it serial device*/
+       mp->cursor = 0;
+ 
+    return 0;
+ }
+ 
  // #endif
- 
\ No newline at end of file
@@ -0,0 +1,167 @@
+// #ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Page fault frequency load control mm/mm-pff.c
+ */
+
+ #include "mm.h"
+ #include "timer.h"
+ #include <stdio.h>
+ #include <pthread.h>
+
+ /*
+  * Major faults, the ones that read a page back from swap, are counted
+  * over windows of a few time slots. A window with more of them than
+  * the threshold means the working sets of the processes do not fit in
+  * MEMRAM together and they keep evicting each other. One process is
+  * then held back, the lowest priority one and of those the one holding
+  * the most memory. The scheduler dispatches it only when nothing else
+  * is ready, so its pages age out and the others can keep theirs. It is
+  * let go after a window with at most half the threshold of faults.
+  *
+  * pff_lock is taken under mm->mm_lock and the scheduler queue lock,
+  * above mmlist_lock.
+  */
+
+ static struct {
+   int threshold;            /* major faults per window, 0 when off */
+   int window;               /* time slots per window */
+   uint64_t win_start;
+   unsigned long win_faults;
+   struct pcb_t *held;
+
+   /* Statistics */
+   unsigned long windows;    /* windows over the threshold */
+   unsigned long holds;      /* processes held back */
+ } pff;
+
+ static pthread_mutex_t pff_lock = PTHREAD_MUTEX_INITIALIZER;
+
+ /* Caller holds pff_lock */
+ static void pff_release(void)
+ {
+   if (pff.held == NULL)
+     return;
+   printf("\tLoad control: released process %d\n", pff.held->pid);
+   pff.held = NULL;
+ }
+
+ /*
+  * pff_roll - close the window when its time slots are over
+  *
+  * Caller holds pff_lock. Windows that passed without any fault count
+  * as quiet ones.
+  */
+ static void pff_roll(void)
+ {
+   uint64_t now = current_time();
+   uint64_t end = pff.win_start + pff.window;
+
+   if (now < end)
+     return;
+
+   if (pff.win_faults > (unsigned long)pff.threshold)
+     pff.windows++;
+ 
+   if (now >= end + pff.window || pff.win_faults <= (unsigned long)pff.threshold / 2)
+   {
+     pff_release();
+   }
+   else if (pff.win_faults > (unsigned long)pff.threshold && pff.held == NULL &&
+            (pff.held = mm_select_holdback()) != NULL)
+   {
+     pff.holds++;
+     printf("\tLoad control: %lu page faults in %d slots, holding back process %d\n",
+            pff.win_faults, pff.window, pff.held->pid);
+   }
+
+   pff.win_start = now - (now - pff.win_start) % pff.window;
+   pff.win_faults = 0;
+ }
+
+ /*
+  * pff_init - turn load control on
+  * @threshold: major faults in a window that hold a process back
+  * @window: time slots of a window
+  */
+ int pff_init(int threshold, int window)
+ {
+   if (threshold <= 0 || window <= 0)
+     return -1;
+
+   pthread_mutex_lock(&pff_lock);
+   pff.threshold = threshold;
+   pff.window = window;
+   pff.win_start = current_time();
+   pff.win_faults = 0;
+   pthread_mutex_unlock(&pff_lock);
+
+   return 0;
+ }
+
+ /*
+  * pff_fault - count a major fault
+  * @caller: faulting process
+  */
+ void pff_fault(struct pcb_t *caller)
+ {
+   pthread_mutex_lock(&pff_lock);
+   if (pff.threshold > 0)
+   {
+     pff_roll();
+     pff.win_faults++;
+   }
+   pthread_mutex_unlock(&pff_lock);
+ }
+
+ /*
+  * pff_held - the process held back by load control, NULL for none
+  *
+  * Only compare the result, the process may be gone once pff_lock is
+  * dropped unless it is known to be in a ready queue.
+  */
+ struct pcb_t *pff_held(void)
+ {
+   struct pcb_t *held;
+
+   pthread_mutex_lock(&pff_lock);
+   if (pff.threshold > 0)
+     pff_roll();
+   held = pff.held;
+   pthread_mutex_unlock(&pff_lock);
+
+   return held;
+ }
+
+ /*
+  * pff_exit - forget a process that is about to be freed
+  * @proc: process
+  */
+ void pff_exit(struct pcb_t *proc)
+ {
+   pthread_mutex_lock(&pff_lock);
+   if (pff.held == proc)
+     pff.held = NULL;
+   pthread_mutex_unlock(&pff_lock);
+ }
+
+ /*
+  * pff_stats - print the load control counters
+  */
+ int pff_stats(void)
+ {
+   pthread_mutex_lock(&pff_lock);
+   if (pff.threshold == 0)
+   {
+     pthread_mutex_unlock(&pff_lock);
+     return -1;
+   }
+
+   printf("load control: %lu windows of %d slots over %d page faults, %lu processes held back\n",
+          pff.windows, pff.window, pff.threshold, pff.holds);
+   pthread_mutex_unlock(&pff_lock);
+
+   return 0;
+ }
+
+ // #endif
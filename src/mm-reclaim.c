@@ -0,0 +1,204 @@
+// #ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Background page reclaim mm/mm-reclaim.c
+ */
+
+ #include "mm.h"
+ #include "timer.h"
+ #include <stdio.h>
+ #include <pthread.h>
+
+ /*
+  * Free MEMRAM frames are kept between two watermarks. An allocation
+  * that leaves fewer than the low watermark free wakes kswapd, which
+  * swaps out the oldest pages of the processes round-robin until the
+  * high watermark is free again. The fault path then mostly finds a
+  * free frame and the device time of the eviction is not charged to
+  * the faulting process.
+  *
+  * kswapd runs in the timer thread between two time slots. No CPU is in
+  * the middle of an instruction then, every address space can be locked
+  * and what it reclaims only depends on the workload, not on the order
+  * the host runs the threads in.
+  *
+  * An allocation that finds MEMRAM empty and has no page of its own to
+  * evict reclaims directly from the other processes instead of failing.
+  * When there is nothing left to evict anywhere, RAM and swap both full,
+  * the OOM killer ends the process holding the most memory.
+  *
+  * kswapd_lock only guards the wakeup and the counters, it is a leaf.
+  */
+
+ static struct {
+   struct memphy_struct *mram;
+   int low;                   /* free frames that wake kswapd */
+   int high;                  /* free frames kswapd stops at */
+   int running;
+   int pending;               /* woken, not served yet */
+
+   /* Statistics */
+   unsigned long wakeups;
+   unsigned long kswapd_pages; /* reclaimed in the background */
+   unsigned long direct_pages; /* reclaimed by a failing allocation */
+   unsigned long direct_fail;
+   unsigned long oom_kills;
+ } kswapd;
+
+ static pthread_mutex_t kswapd_lock = PTHREAD_MUTEX_INITIALIZER;
+
+ /* Free frames of MEMRAM */
+ static int ram_free(struct memphy_struct *mram)
+ {
+   int nr;
+
+   pthread_mutex_lock(&mram->lock);
+   nr = mram->free_fpnum;
+   pthread_mutex_unlock(&mram->lock);
+
+   return nr;
+ }
+
+ /*
+  * kswapd_balance - reclaim up to the high watermark when it was woken
+  * during the slot that just ended
+  */
+ static void kswapd_balance(void)
+ {
+   int nr;
+
+   pthread_mutex_lock(&kswapd_lock);
+   if (!kswapd.pending)
+   {
+     pthread_mutex_unlock(&kswapd_lock);
+     return;
+   }
+   kswapd.pending = 0;
+   kswapd.wakeups++;
+   pthread_mutex_unlock(&kswapd_lock);
+
+   /* Stop early when nothing can be evicted, the next wakeup retries */
+   while ((nr = kswapd.high - ram_free(kswapd.mram)) > 0 &&
+          (nr = mm_reclaim(NULL, nr)) > 0)
+   {
+     pthread_mutex_lock(&kswapd_lock);
+     kswapd.kswapd_pages += nr;
+     pthread_mutex_unlock(&kswapd_lock);
+   }
+ }
+
+ /*
+  * kswapd_init - start the background reclaimer of MEMRAM, before the CPUs
+  * @mram: MEMRAM
+  * @low: free frames under which it is woken
+  * @high: free frames it reclaims up to
+  */
+ int kswapd_init(struct memphy_struct *mram, int low, int high)
+ {
+   if (mram == NULL || low <= 0 || high < low || kswapd.running)
+     return -1;
+
+   kswapd.mram = mram;
+   kswapd.low = low;
+   kswapd.high = high;
+   kswapd.running = 1;
+   set_slot_hook(kswapd_balance);
+
+   return 0;
+ }
+
+ /*
+  * kswapd_exit - stop the background reclaimer
+  */
+ void kswapd_exit(void)
+ {
+   if (!kswapd.running)
+     return;
+
+   set_slot_hook(NULL);
+   kswapd.running = 0;
+ }
+
+ /*
+  * kswapd_wakeup - wake kswapd when MEMRAM dropped under the low watermark
+  * @mram: device frames were just taken from
+  */
+ void kswapd_wakeup(struct memphy_struct *mram)
+ {
+   if (!kswapd.running || mram != kswapd.mram || ram_free(mram) >= kswapd.low)
+     return;
+
+   pthread_mutex_lock(&kswapd_lock);
+   kswapd.pending = 1;
+   pthread_mutex_unlock(&kswapd_lock);
+ }
+
+ /*
+  * try_to_free_pages - direct reclaim for an allocation that found no frame
+  * @caller: allocating process, its own address space is left alone
+  *
+  * It does not wait when every other address space is busy or empty, the
+  * caller holds its own mm_lock and a wait would keep the other processes
+  * from its pages too. Return 0 when a frame went back to MEMRAM.
+  */
+ int try_to_free_pages(struct pcb_t *caller)
+ {
+   int nr = mm_reclaim(caller, 1);
+
+   pthread_mutex_lock(&kswapd_lock);
+   if (nr > 0)
+     kswapd.direct_pages += nr;
+   else
+     kswapd.direct_fail++;
+   pthread_mutex_unlock(&kswapd_lock);
+   kswapd_wakeup(caller->mram);
+
+   return nr > 0 ? 0 : -1;
+ }
+ 
+ /*
+  * out_of_memory - last resort of an allocation direct reclaim did not serve
+  * @caller: allocating process
+  *
+  * Return 0 when another process was killed and its frames are free.
+  */
+ int out_of_memory(struct pcb_t *caller)
+ {
+   int ret = oom_kill(caller);
+ 
+   if (ret >= 0)
+   {
+     pthread_mutex_lock(&kswapd_lock);
+     kswapd.oom_kills++;
+     pthread_mutex_unlock(&kswapd_lock);
+   }
+ 
+   return ret == 0 ? 0 : -1;
+ }
+
+ /*
+  * reclaim_stats - print the background and direct reclaim counters
+  */
+ int reclaim_stats(void)
+ {
+   pthread_mutex_lock(&kswapd_lock);
+   if (kswapd.wakeups == 0 && kswapd.direct_pages == 0 && kswapd.direct_fail == 0 &&
+       kswapd.oom_kills == 0)
+   {
+     pthread_mutex_unlock(&kswapd_lock);
+     return -1;
+   }
+
+   if (kswapd.mram != NULL)
+     printf("kswapd: watermarks low %d high %d, woken %lu times, reclaimed %lu pages\n",
+            kswapd.low, kswapd.high, kswapd.wakeups, kswapd.kswapd_pages);
+   printf("direct reclaim: %lu pages, %lu allocations found nothing to evict\n",
+          kswapd.direct_pages, kswapd.direct_fail);
+   if (kswapd.oom_kills)
+     printf("oom killer: %lu processes killed\n", kswapd.oom_kills);
+   pthread_mutex_unlock(&kswapd_lock);
+
+   return 0;
+ }
+
+ // #endif
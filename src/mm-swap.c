@@ -0,0 +1,239 @@
+// #ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Swap device module mm/mm-swap.c
+ */
+
+ #include "mm.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <pthread.h>
+
+ /* Last device that received a swap frame, the round-robin rotor */
+ static int swap_rotor = -1;
+ static pthread_mutex_t swap_lock = PTHREAD_MUTEX_INITIALIZER; /* device choice */
+
+ /*
+  * swap_device - get the MEMSWP of a swap type
+  * @caller: caller
+  * @swptyp: swap type, index of the device in caller->mswp
+  */
+ struct memphy_struct *swap_device(struct pcb_t *caller, int swptyp)
+ {
+   if (caller == NULL || caller->mswp == NULL || swptyp < 0 || swptyp >= PAGING_MAX_MMSWP)
+     return NULL;
+
+   return caller->mswp[swptyp];
+ }
+
+ /*
+  * swap_avail - device can hold one more swapped page
+  *
+  * Only a hint read without the device lock, the allocation decides.
+  */
+ static int swap_avail(struct memphy_struct *mp)
+ {
+   return mp != NULL && mp->maxfp > 0 && mp->free_fpnum > 0;
+ }
+
+ /*
+  * swap_get_freefp - get a free swap frame over all swap devices
+  * @caller: caller
+  * @retswptyp: returned swap type
+  * @retswpfpn: returned swap frame
+  *
+  * The highest priority device with room is used, devices of equal
+  * priority are striped round-robin. A device that fills up (or whose
+  * frames no longer fit the PTE swap offset) falls back to the next one.
+  * The chosen device becomes the caller active swap.
+  */
+ int swap_get_freefp(struct pcb_t *caller, int *retswptyp, int *retswpfpn)
+ {
+   int tried[PAGING_MAX_MMSWP] = { 0 };
+   struct memphy_struct *mp;
+   int it, swptyp, best, fpn;
+
+   if (caller == NULL || retswptyp == NULL || retswpfpn == NULL)
+     return -1;
+
+   pthread_mutex_lock(&swap_lock);
+   for (;;) {
+     /* Best priority among the devices with room */
+     best = -1;
+     for (it = 0; it < PAGING_MAX_MMSWP; it++) {
+       mp = swap_device(caller, it);
+       if (!tried[it] && swap_avail(mp) &&
+           (best == -1 || mp->swp_prio > swap_device(caller, best)->swp_prio))
+         best = it;
+     }
+     if (best == -1) {
+       pthread_mutex_unlock(&swap_lock);
+       return -1; /* all swap devices are full */
+     }
+
+     /* Next device of that priority after the rotor */
+     swptyp = best;
+     for (it = 1; it <= PAGING_MAX_MMSWP; it++) {
+       int cand = (swap_rotor + it + PAGING_MAX_MMSWP) % PAGING_MAX_MMSWP;
+
+       mp = swap_device(caller, cand);
+       if (!tried[cand] && swap_avail(mp) &&
+           mp->swp_prio == swap_device(caller, best)->swp_prio) {
+         swptyp = cand;
+         break;
+       }
+     }
+
+     mp = swap_device(caller, swptyp);
+     tried[swptyp] = 1;
+     if (MEMPHY_get_freefp(mp, &fpn) != 0)
+       continue;
+     if (fpn > PAGING_MAX_SWPOFF) {
+       MEMPHY_put_freefp(mp, fpn);
+       continue;
+     }
+
+     swap_rotor = swptyp;
+     caller->active_mswp = mp;
+     caller->active_mswp_id = swptyp;
+     *retswptyp = swptyp;
+     *retswpfpn = fpn;
+     pthread_mutex_unlock(&swap_lock);
+     return 0;
+   }
+ }
+
+ /*
+  * swap_put_freefp - give a swap frame back to the device it came from
+  * @caller: caller
+  * @swptyp: swap type stored in the PTE
+  * @swpfpn: swap frame stored in the PTE
+  */
+ int swap_put_freefp(struct pcb_t *caller, int swptyp, int swpfpn)
+ {
+   struct memphy_struct *mp = swap_device(caller, swptyp);
+ 
+   if (swptyp == PAGING_ZSWAP_SWPTYP)
+     return zswap_invalidate(swpfpn);
+
+   if (mp == NULL)
+     return -1;
+
+   /* Still referenced by a forked address space */
+   pthread_mutex_lock(&mp->lock);
+   if (mp->frames[swpfpn].mapcount > 0)
+   {
+     mp->frames[swpfpn].mapcount--;
+     pthread_mutex_unlock(&mp->lock);
+     return 0;
+   }
+   pthread_mutex_unlock(&mp->lock);
+
+   return MEMPHY_put_freefp(mp, swpfpn);
+ }
+
+ /*
+  * swap_dup - take one more reference on a swapped page
+  * @caller: caller
+  * @mm: address space of the new reference
+  * @pgn: page number of the new reference
+  * @swptyp: swap type, updated when the page had to be copied
+  * @swpfpn: swap frame, updated when the page had to be copied
+  *
+  * Device frames are shared, pooled pages get their own zswap entry.
+  */
+ int swap_dup(struct pcb_t *caller, struct mm_struct *mm, int pgn, int *swptyp, int *swpfpn)
+ {
+   struct memphy_struct *mp;
+
+   if (*swptyp == PAGING_ZSWAP_SWPTYP)
+     return zswap_dup(caller, mm, pgn, swptyp, swpfpn);
+
+   if ((mp = swap_device(caller, *swptyp)) == NULL)
+     return -1;
+
+   pthread_mutex_lock(&mp->lock);
+   mp->frames[*swpfpn].mapcount++;
+   pthread_mutex_unlock(&mp->lock);
+   return 0;
+ }
+
+ /*
+  * swap_cache_add - keep the swap frame a page was read from
+  * @caller: caller
+  * @fpn: MEMRAM frame now holding the page
+  * @swptyp: swap type of the slot
+  * @swpfpn: swap frame of the slot
+  *
+  * While the page stays clean the slot is a valid copy, evicting it
+  * again only has to point the PTE back to the slot.
+  *
+  * The cache fields belong to the MEMRAM frame table, the mappings of a
+  * shared frame reach them with different address space locks held.
+  */
+ int swap_cache_add(struct pcb_t *caller, int fpn, int swptyp, int swpfpn)
+ {
+   struct frame_struct *fr;
+
+   if (caller == NULL || caller->mram == NULL || fpn < 0 || fpn >= caller->mram->maxfp)
+     return -1;
+
+   swap_cache_drop(caller, fpn);
+   fr = &caller->mram->frames[fpn];
+   pthread_mutex_lock(&caller->mram->lock);
+   fr->flags |= FRAME_SWAPCACHE;
+   fr->swp_typ = swptyp;
+   fr->swp_off = swpfpn;
+   pthread_mutex_unlock(&caller->mram->lock);
+
+   return 0;
+ }
+
+ /*
+  * swap_cache_take - detach the cached slot of a frame
+  * @caller: caller
+  * @fpn: MEMRAM frame
+  * @swptyp: returned swap type
+  * @swpfpn: returned swap frame
+  *
+  * Return 0 and hand the slot over to the caller, -1 if none is cached.
+  */
+ int swap_cache_take(struct pcb_t *caller, int fpn, int *swptyp, int *swpfpn)
+ {
+   struct frame_struct *fr;
+
+   if (caller == NULL || caller->mram == NULL || fpn < 0 || fpn >= caller->mram->maxfp)
+     return -1;
+
+   fr = &caller->mram->frames[fpn];
+   pthread_mutex_lock(&caller->mram->lock);
+   if (!(fr->flags & FRAME_SWAPCACHE))
+   {
+     pthread_mutex_unlock(&caller->mram->lock);
+     return -1;
+   }
+
+   fr->flags &= ~FRAME_SWAPCACHE;
+   *swptyp = fr->swp_typ;
+   *swpfpn = fr->swp_off;
+   pthread_mutex_unlock(&caller->mram->lock);
+
+   return 0;
+ }
+
+ /*
+  * swap_cache_drop - release the cached slot of a frame
+  * @caller: caller
+  * @fpn: MEMRAM frame that got dirty or freed
+  */
+ int swap_cache_drop(struct pcb_t *caller, int fpn)
+ {
+   int swptyp, swpfpn;
+
+   if (swap_cache_take(caller, fpn, &swptyp, &swpfpn) != 0)
+     return 0;
+
+   return swap_put_freefp(caller, swptyp, swpfpn);
+ }
+
+ // #endif
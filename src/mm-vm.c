@@ -7,6 +7,7 @@
 
  #include "string.h"
  #include "mm.h"
+ #include "RBTree.h"
  #include <stdlib.h>
  #include <stdio.h>
  #include <pthread.h>
@@ -20,27 +21,230 @@
  {
    struct vm_area_struct *pvma = mm->mmap;
  
-   if (mm->mmap == NULL)
+   /* The list is in address order, IDs are not */
+   while (pvma != NULL && pvma->vm_id != vmaid)
+     pvma = pvma->vm_next;
+ 
+   return pvma;
+ }
+ 
+ #define VMA_OF(node) ((struct vm_area_struct *)(node)->data->item)
+ 
+ /*vma_rb_augment - recompute the largest gap below a subtree
+  *@node: area tree node
+  */
+ static void vma_rb_augment(struct RBNode *node)
+ {
+   struct vm_area_struct *vma = VMA_OF(node);
+   unsigned long max = vma->vm_gap;
+ 
+   if (node->left && VMA_OF(node->left)->vm_subtree_gap > max)
+     max = VMA_OF(node->left)->vm_subtree_gap;
+   if (node->right && VMA_OF(node->right)->vm_subtree_gap > max)
+     max = VMA_OF(node->right)->vm_subtree_gap;
+   vma->vm_subtree_gap = max;
+ }
+ 
+ /*vma_floor - last area starting at or below an address
+  *@mm: memory management struct
+  *@addr: address
+  */
+ static struct RBNode *vma_floor(struct mm_struct *mm, unsigned long addr)
+ {
+   struct RBNode *node = mm->mm_rb, *floor = NULL;
+ 
+   while (node != NULL)
+   {
+     if (VMA_OF(node)->vm_start <= addr)
+     {
+       floor = node;
+       node = node->right;
+     }
+     else
+       node = node->left;
+   }
+ 
+   return floor;
+ }
+ 
+ /*find_vma - find the area holding an address
+  *@mm: memory management struct
+  *@addr: address
+  */
+ struct vm_area_struct *find_vma(struct mm_struct *mm, unsigned long addr)
+ {
+   struct RBNode *node = vma_floor(mm, addr);
+ 
+   if (node == NULL || addr >= VMA_OF(node)->vm_end)
      return NULL;
  
-   int vmait = pvma->vm_id;
+   return VMA_OF(node);
+ }
+ 
+ /*vma_set_gap - recompute the gap below an area from its predecessor
+  *@node: area tree node
+  */
+ static void vma_set_gap(struct RBNode *node)
+ {
+   struct RBNode *prev = prevNode(node);
+   struct vm_area_struct *vma = VMA_OF(node);
+ 
+   vma->vm_gap = vma->vm_start - (prev ? VMA_OF(prev)->vm_end : 0);
+   augmentPath(node);
+ }
+ 
+ /*vma_update_gap - an area changed its end, fix the gap above it
+  *@mm: memory management struct
+  *@vma: area
+  */
+ void vma_update_gap(struct mm_struct *mm, struct vm_area_struct *vma)
+ {
+   struct RBNode *next;
+ 
+   if (vma->vm_rb == NULL)
+     return;
+ 
+   next = nextNode(vma->vm_rb);
+   if (next != NULL)
+     vma_set_gap(next);
+ }
+ 
+ /*vma_link - add an area to the list and the tree of a mm
+  *@mm: memory management struct
+  *@vma: area, must not overlap any other
+  */
+ int vma_link(struct mm_struct *mm, struct vm_area_struct *vma)
+ {
+   Dtype *data = malloc(sizeof(Dtype));
+   struct RBNode *prev;
  
-   while (vmait < vmaid)
+   if (data == NULL)
+     return -1;
+ 
+   data->proc = NULL;
+   data->key = vma->vm_start;
+   data->timestamp = vma->vm_id;
+   data->item = vma;
+   data->augment = vma_rb_augment;
+   vma->vm_gap = vma->vm_subtree_gap = 0;
+ 
+   insertNode(&mm->mm_rb, data);
+   vma->vm_rb = findNode(mm->mm_rb, data);
+   vma->vm_mm = mm;
+ 
+   /* The list keeps the address order of the tree */
+   prev = prevNode(vma->vm_rb);
+   if (prev != NULL)
    {
-     if (pvma == NULL)
-       return NULL;
+     vma->vm_next = VMA_OF(prev)->vm_next;
+     VMA_OF(prev)->vm_next = vma;
+   }
+   else
+   {
+     vma->vm_next = mm->mmap;
+     mm->mmap = vma;
+   }
  
-     pvma = pvma->vm_next;
-     vmait = pvma->vm_id;
+   vma_set_gap(vma->vm_rb);
+   vma_update_gap(mm, vma);
+   return 0;
+ }
+ 
+ /*vma_unlink - remove an area from the list and the tree of a mm
+  *@mm: memory management struct
+  *@vma: area, the caller frees it
+  */
+ void vma_unlink(struct mm_struct *mm, struct vm_area_struct *vma)
+ {
+   struct vm_area_struct **pvma;
+   struct vm_area_struct *next = vma->vm_next;
+   Dtype key;
+ 
+   for (pvma = &mm->mmap; *pvma != NULL; pvma = &(*pvma)->vm_next)
+   {
+     if (*pvma == vma)
+     {
+       *pvma = vma->vm_next;
+       break;
+     }
    }
  
-   return pvma;
+   key.key = vma->vm_start;
+   key.timestamp = vma->vm_id;
+   deleteNode(&mm->mm_rb, &key);
+   vma->vm_rb = NULL;
+   vma->vm_next = NULL;
+ 
+   /* The gap of the next area now reaches down to the previous one */
+   if (next != NULL)
+     vma_set_gap(next->vm_rb);
  }
  
- int __mm_swap_page(struct pcb_t *caller, int vicfpn , int swpfpn)
+ /*vma_gap_search - lowest area with a gap of size above low below it
+  *@node: subtree
+  *@low: lowest address of the range
+  *@size: range size
+  *
+  * Subtrees whose largest gap is too small are skipped, the left one
+  * only holds gaps below the node.
+  */
+ static struct vm_area_struct *vma_gap_search(struct RBNode *node, unsigned long low,
+                                              unsigned long size)
  {
-     __swap_cp_page(caller->mram, vicfpn, caller->active_mswp, swpfpn);
+   struct vm_area_struct *vma, *found;
+   unsigned long gap_start;
+ 
+   if (node == NULL || VMA_OF(node)->vm_subtree_gap < size)
+     return NULL;
+ 
+   vma = VMA_OF(node);
+   if (vma->vm_start >= low + size &&
+       (found = vma_gap_search(node->left, low, size)) != NULL)
+     return found;
+ 
+   gap_start = vma->vm_start - vma->vm_gap;
+   if (gap_start < low)
+     gap_start = low;
+   if (vma->vm_gap >= size && vma->vm_start >= gap_start + size)
+     return vma;
+ 
+   return vma_gap_search(node->right, low, size);
+ }
+ 
+ /*get_unmapped_area - first free range of a size at or above an address
+  *@mm: memory management struct
+  *@low: lowest address
+  *@size: range size
+  *
+  * Return the start of the range, or 0 when the space is full.
+  */
+ unsigned long get_unmapped_area(struct mm_struct *mm, unsigned long low, unsigned long size)
+ {
+   struct vm_area_struct *vma;
+   struct RBNode *last;
+   unsigned long start;
+ 
+   vma = vma_gap_search(mm->mm_rb, low, size);
+   if (vma != NULL)
+   {
+     start = vma->vm_start - vma->vm_gap;
+     return start < low ? low : start;
+   }
+ 
+   /* Above the last area */
+   last = getMaxNode(mm->mm_rb);
+   start = last ? VMA_OF(last)->vm_end : 0;
+   if (start < low)
+     start = low;
+   if (start + size > PAGING_MAX_PGN * PAGING_PAGESZ)
      return 0;
+ 
+   return start;
+ }
+ 
+ int __mm_swap_page(struct pcb_t *caller, int vicfpn , int swpfpn)
+ {
+     return __swap_cp_page(caller->mram, vicfpn, caller->active_mswp, swpfpn);
  }
  
  /*get_vm_area_node - get vm area for a number of pages
@@ -83,24 +287,22 @@
   */
  int validate_overlap_vm_area(struct pcb_t *caller, int vmaid, int vmastart, int vmaend)
  {
-   // Below was commented first
-   struct vm_area_struct *vma = caller->mm->mmap;
- 
-   /* TODO validate the planned memory area is not overlapped */
-   while (vma != NULL) {
-     if (vma->vm_id != vmaid) {
-       if ((vmastart >= vma->vm_start && vma->vm_start < vmaend) || 
-           (vmaend > vma->vm_start && vma->vm_end >= vmaend) ||
-           (vmastart <= vma->vm_start && vma->vm_end <= vmaend)) {
-           return -1;
-       }
-     }
-     vma = vma -> vm_next;
+   struct RBNode *node;
+ 
+   if (vmaend > PAGING_MAX_PGN * PAGING_PAGESZ) {
+     return -1; // Exceeds the address space
    }
-   /* Also check if the new area exceeds vm_end of the target vma */
-   struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
-   if (vmaend > cur_vma->vm_end) {
-     return -1; // Exceeds the vm area limit
+ 
+   /* TODO validate the planned memory area is not overlapped
+    * Areas do not overlap each other, walking down from the last one
+    * starting below vmaend stops at the first one ending below vmastart */
+   for (node = vma_floor(caller->mm, vmaend - 1); node != NULL; node = prevNode(node)) {
+     struct vm_area_struct *vma = VMA_OF(node);
+ 
+     if (vma->vm_end <= (unsigned long)vmastart)
+       break;
+     if (vma->vm_id != vmaid && vma->vm_start < vma->vm_end)
+       return -1;
    }
    
    return 0; // No overlap
@@ -115,7 +317,6 @@
  int inc_vma_limit(struct pcb_t *caller, int vmaid, int inc_sz)
  {
    printf("Called inc_vma_limit\n");
-   struct vm_rg_struct * newrg = malloc(sizeof(struct vm_rg_struct));
    int inc_amt = PAGING_PAGE_ALIGNSZ(inc_sz);
    int incnumpage =  inc_amt / PAGING_PAGESZ;
    struct vm_rg_struct *area = get_vm_area_node_at_brk(caller, vmaid, inc_sz, inc_amt);
@@ -125,9 +326,6 @@
      if (area != NULL) {
        free(area);
      }
-     if (newrg != NULL) {
-       free(newrg);
-     }
      return -1; // Failed to get area or vma
    }
   //  int old_end = cur_vma->vm_end;
@@ -135,7 +333,6 @@
    /*Validate overlap of obtained region */
    if (validate_overlap_vm_area(caller, vmaid, area->rg_start, area->rg_end) < 0) {
     free(area);
-    free(newrg);
     return -1; /* Overlap and failed allocation */
   }
  
@@ -144,21 +341,60 @@
    // inc_limit_ret...
    if (area->rg_end > cur_vma->vm_end) {
      cur_vma->vm_end = area->rg_end;
+     vma_update_gap(caller->mm, cur_vma);
    }
    cur_vma->sbrk = area->rg_end;
  
-   int inc_limit_ret = vm_map_ram(caller, area->rg_start, 
-     area->rg_end, area->rg_start, incnumpage, newrg);
+   /* Only reserve the pages, frames come on first touch */
+   int inc_limit_ret = vmap_reserve_range(caller, area->rg_start, incnumpage);
  
    free(area); // Free the temporary area struct
    
    if (inc_limit_ret < 0) {
-     free(newrg);
      return -1; /* Failed to map memory */
    }
  
    return 0;
  }
  
+ /*vm_map_area - map a new area of reserved pages
+  *@caller: caller
+  *@size: area size
+  *
+  * The area goes to the first gap above VM_MMAP_BASE and takes the next
+  * free ID. Return the area, or NULL when no gap is large enough.
+  */
+ struct vm_area_struct *vm_map_area(struct pcb_t *caller, int size)
+ {
+   struct vm_area_struct *vma, *it;
+   unsigned long start, inc_amt = PAGING_PAGE_ALIGNSZ(size);
+ 
+   if (caller == NULL || size <= 0)
+     return NULL;
+ 
+   start = get_unmapped_area(caller->mm, VM_MMAP_BASE, inc_amt);
+   if (start == 0)
+     return NULL;
+ 
+   vma = malloc(sizeof(struct vm_area_struct));
+   vma->vm_id = 0;
+   for (it = caller->mm->mmap; it != NULL; it = it->vm_next)
+     if (it->vm_id >= vma->vm_id)
+       vma->vm_id = it->vm_id + 1;
+   vma->vm_start = start;
+   vma->vm_end = vma->sbrk = start + inc_amt;
+   vma->vm_freerg_list = NULL;
+   memset(&vma->vm_freerg_idx, 0, sizeof(struct vm_rg_index));
+ 
+   if (vmap_reserve_range(caller, start, inc_amt / PAGING_PAGESZ) < 0 ||
+       vma_link(caller->mm, vma) < 0)
+   {
+     free(vma);
+     return NULL;
+   }
+ 
+   return vma;
+ }
+ 
  // #endif
  
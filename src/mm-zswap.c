@@ -0,0 +1,527 @@
+// #ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Compressed swap pool mm/mm-zswap.c
+ */
+
+ #include "mm.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <pthread.h>
+
+ /*
+  * Pages evicted from MEMRAM are compressed into a RAM arena before any
+  * MEMSWP is touched. A pooled page has swap type PAGING_ZSWAP_SWPTYP
+  * and its entry index as swap offset. When the arena is full the oldest
+  * entries are written back to a real swap device.
+  *
+  * zswap_lock protects the whole pool. It is taken below the address
+  * space locks and above the swap device locks, see libmem.c.
+  */
+
+ #define ZSWAP_CHUNK 16                               /* arena allocation unit */
+ #define ZSWAP_MAX_LEN (PAGING_PAGESZ * 3 / 4)        /* worse pages go to swap */
+ #define ZSWAP_MIN_MATCH 3
+
+ struct zswap_entry {
+   int used;
+   int chunk;                 /* first arena chunk, -1 for same filled */
+   int len;                   /* compressed length in bytes */
+   BYTE fill;                 /* value of a same filled page */
+   unsigned long seq;         /* store order, oldest is written back first */
+   struct mm_struct *mm;      /* owner PTE, updated on writeback */
+   int pgn;
+ };
+
+ static struct {
+   BYTE *arena;
+   BYTE *chunk_used;
+   int nr_chunks;
+   struct zswap_entry *entries;
+   int nr_entries;
+   unsigned long seq;
+
+   /* Statistics */
+   unsigned long stored;      /* pages taken by the pool */
+   unsigned long same_filled;
+   unsigned long rejected;    /* did not compress well enough */
+   unsigned long written_back;
+   unsigned long hits;        /* swap-ins served by the pool */
+   unsigned long misses;      /* swap-ins served by a MEMSWP */
+   unsigned long in_bytes;    /* page bytes ever stored */
+   unsigned long out_bytes;   /* compressed bytes ever stored */
+   unsigned long pool_bytes;  /* compressed bytes held now */
+ } zswap;
+ 
+ static pthread_mutex_t zswap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+ /*
+  * zswap_init - create the pool
+  * @pool_sz: arena size in bytes, 0 leaves zswap off
+  */
+ int zswap_init(int pool_sz)
+ {
+   if (pool_sz <= 0)
+     return 0;
+
+   zswap.nr_chunks = pool_sz / ZSWAP_CHUNK;
+   zswap.arena = malloc(zswap.nr_chunks * ZSWAP_CHUNK);
+   zswap.chunk_used = calloc(zswap.nr_chunks, sizeof(BYTE));
+   /* Same filled pages take no chunk, leave room for them as well */
+   zswap.nr_entries = 2 * zswap.nr_chunks;
+   if (zswap.nr_entries > PAGING_MAX_SWPOFF + 1)
+     zswap.nr_entries = PAGING_MAX_SWPOFF + 1;
+   zswap.entries = calloc(zswap.nr_entries, sizeof(struct zswap_entry));
+
+   if (zswap.arena == NULL || zswap.chunk_used == NULL || zswap.entries == NULL)
+   {
+     printf("zswap_init: cannot allocate a pool of %d bytes\n", pool_sz);
+     zswap.nr_chunks = zswap.nr_entries = 0;
+     return -1;
+   }
+
+   return 0;
+ }
+
+ int zswap_enabled(void)
+ {
+   return zswap.nr_entries > 0;
+ }
+
+ /*
+  * zswap_compress - LZ77 style compression of one page
+  * @src: page content
+  * @dst: output, at least ZSWAP_MAX_LEN bytes
+  *
+  * A token byte below 0x80 is followed by (token + 1) literals, a token
+  * byte from 0x80 copies (token - 0x80 + ZSWAP_MIN_MATCH) bytes starting
+  * (next byte + 1) bytes back. Return the output length, -1 if the page
+  * does not fit in ZSWAP_MAX_LEN.
+  */
+ static int zswap_compress(const BYTE *src, BYTE *dst)
+ {
+   int ip = 0, op = 0, lit = -1;
+
+   while (ip < PAGING_PAGESZ)
+   {
+     int best_len = 0, best_dist = 0, dist;
+
+     for (dist = 1; dist <= 256 && dist <= ip; dist++)
+     {
+       int len = 0;
+
+       while (ip + len < PAGING_PAGESZ && len < 0x7f + ZSWAP_MIN_MATCH &&
+              src[ip + len] == src[ip + len - dist])
+         len++;
+       if (len > best_len)
+       {
+         best_len = len;
+         best_dist = dist;
+       }
+     }
+
+     if (best_len >= ZSWAP_MIN_MATCH)
+     {
+       if (op + 2 > ZSWAP_MAX_LEN)
+         return -1;
+       dst[op++] = (BYTE)(0x80 + best_len - ZSWAP_MIN_MATCH);
+       dst[op++] = (BYTE)(best_dist - 1);
+       ip += best_len;
+       lit = -1;
+       continue;
+     }
+
+     /* Literal, extend the open run when possible */
+     if (lit < 0 || dst[lit] == 0x7f)
+     {
+       if (op + 2 > ZSWAP_MAX_LEN)
+         return -1;
+       lit = op;
+       dst[op++] = 0;
+     }
+     else
+     {
+       if (op + 1 > ZSWAP_MAX_LEN)
+         return -1;
+       dst[lit]++;
+     }
+     dst[op++] = src[ip++];
+   }
+
+   return op;
+ }
+
+ /*
+  * zswap_decompress - inverse of zswap_compress
+  */
+ static int zswap_decompress(const BYTE *src, int len, BYTE *dst)
+ {
+   int ip = 0, op = 0, n;
+
+   while (ip < len)
+   {
+     unsigned char tok = (unsigned char)src[ip++];
+
+     if (tok < 0x80)
+     {
+       n = tok + 1;
+       if (op + n > PAGING_PAGESZ || ip + n > len)
+         return -1;
+       memcpy(&dst[op], &src[ip], n);
+       ip += n;
+       op += n;
+     }
+     else
+     {
+       int dist;
+
+       if (ip >= len)
+         return -1;
+       n = tok - 0x80 + ZSWAP_MIN_MATCH;
+       dist = (unsigned char)src[ip++] + 1;
+       if (dist > op || op + n > PAGING_PAGESZ)
+         return -1;
+       for (; n > 0; n--, op++)
+         dst[op] = dst[op - dist];
+     }
+   }
+
+   return (op == PAGING_PAGESZ) ? 0 : -1;
+ }
+
+ /*
+  * zswap_chunk_alloc - first fit run of free arena chunks
+  */
+ static int zswap_chunk_alloc(int nr)
+ {
+   int it, run = 0;
+
+   for (it = 0; it < zswap.nr_chunks; it++)
+   {
+     run = zswap.chunk_used[it] ? 0 : run + 1;
+     if (run == nr)
+     {
+       memset(&zswap.chunk_used[it - nr + 1], 1, nr);
+       return it - nr + 1;
+     }
+   }
+
+   return -1;
+ }
+
+ static int zswap_entry_alloc(void)
+ {
+   int it;
+
+   for (it = 0; it < zswap.nr_entries; it++)
+     if (!zswap.entries[it].used)
+       return it;
+
+   return -1;
+ }
+
+ static void zswap_entry_free(int idx)
+ {
+   struct zswap_entry *ze = &zswap.entries[idx];
+
+   if (ze->chunk >= 0)
+     memset(&zswap.chunk_used[ze->chunk], 0, DIV_ROUND_UP(ze->len, ZSWAP_CHUNK));
+   zswap.pool_bytes -= ze->len;
+   ze->used = 0;
+ }
+
+ static int zswap_entry_read(int idx, BYTE *page)
+ {
+   struct zswap_entry *ze = &zswap.entries[idx];
+
+   if (ze->chunk < 0)
+   {
+     memset(page, ze->fill, PAGING_PAGESZ);
+     return 0;
+   }
+
+   return zswap_decompress(&zswap.arena[ze->chunk * ZSWAP_CHUNK], ze->len, page);
+ }
+
+ /*
+  * zswap_writeback - move the oldest pooled page to a real swap device
+  * @caller: caller, owner of the swap device table
+  * @held: address space the caller holds locked besides its own
+  *
+  * Writing back updates the PTE of the owner. The owner lock is only
+  * tried, when it is busy the oldest page of a locked owner goes instead.
+  */
+ static int zswap_writeback(struct pcb_t *caller, struct mm_struct *held)
+ {
+   BYTE page[PAGING_PAGESZ];
+   struct zswap_entry *ze;
+   int it, idx = -1, own = -1, locked = 0;
+   int swptyp, swpfpn, ret = -1;
+
+   for (it = 0; it < zswap.nr_entries; it++)
+   {
+     ze = &zswap.entries[it];
+     if (!ze->used)
+       continue;
+     if (idx == -1 || ze->seq < zswap.entries[idx].seq)
+       idx = it;
+     if ((ze->mm == held || ze->mm == caller->mm) &&
+         (own == -1 || ze->seq < zswap.entries[own].seq))
+       own = it;
+   }
+   if (idx == -1)
+     return -1;
+
+   ze = &zswap.entries[idx];
+   if (ze->mm != held && ze->mm != caller->mm)
+   {
+     if (pthread_mutex_trylock(&ze->mm->mm_lock) == 0)
+       locked = 1;
+     else if ((idx = own) == -1)
+       return -1;
+     ze = &zswap.entries[idx];
+   }
+
+   if (zswap_entry_read(idx, page) == 0 &&
+       swap_get_freefp(caller, &swptyp, &swpfpn) == 0)
+   {
+     if (MEMPHY_write_page(swap_device(caller, swptyp), swpfpn, page) == 0)
+     {
+       pte_set_swap(&ze->mm->pgd[ze->pgn], swptyp, swpfpn);
+       zswap_entry_free(idx);
+       zswap.written_back++;
+       ret = 0;
+     }
+     else
+       swap_put_freefp(caller, swptyp, swpfpn);
+   }
+
+   if (locked)
+     pthread_mutex_unlock(&ze->mm->mm_lock);
+   return ret;
+ }
+
+ /*
+  * zswap_store - compress an evicted page into the pool
+  * @caller: caller
+  * @mm: owner of the page
+  * @pgn: page number
+  * @fpn: MEMRAM frame holding the page
+  * @retswptyp: returned swap type
+  * @retswpoff: returned swap offset
+  *
+  * Return 0 when the pool took the page, -1 when it has to go to a
+  * swap device.
+  */
+ int zswap_store(struct pcb_t *caller, struct mm_struct *mm, int pgn, int fpn,
+                 int *retswptyp, int *retswpoff)
+ {
+   BYTE page[PAGING_PAGESZ], buf[ZSWAP_MAX_LEN];
+   struct zswap_entry *ze;
+   int idx, len = 0, chunk = -1, it;
+
+   if (!zswap_enabled() || MEMPHY_read_page(caller->mram, fpn, page) != 0)
+     return -1;
+
+   /* Same filled pages only keep the fill value */
+   for (it = 1; it < PAGING_PAGESZ && page[it] == page[0]; it++)
+     ;
+   pthread_mutex_lock(&zswap_lock);
+   if (it < PAGING_PAGESZ && (len = zswap_compress(page, buf)) < 0)
+   {
+     zswap.rejected++;
+     pthread_mutex_unlock(&zswap_lock);
+     return -1;
+   }
+
+   /* Make room by writing the oldest pages back */
+   while ((idx = zswap_entry_alloc()) < 0 ||
+          (len > 0 && (chunk = zswap_chunk_alloc(DIV_ROUND_UP(len, ZSWAP_CHUNK))) < 0))
+   {
+     if (zswap_writeback(caller, mm) != 0)
+     {
+       pthread_mutex_unlock(&zswap_lock);
+       return -1;
+     }
+   }
+
+   ze = &zswap.entries[idx];
+   ze->used = 1;
+   ze->chunk = chunk;
+   ze->len = len;
+   ze->fill = page[0];
+   ze->seq = zswap.seq++;
+   ze->mm = mm;
+   ze->pgn = pgn;
+   if (chunk >= 0)
+     memcpy(&zswap.arena[chunk * ZSWAP_CHUNK], buf, len);
+   else
+     zswap.same_filled++;
+
+   zswap.stored++;
+   zswap.in_bytes += PAGING_PAGESZ;
+   zswap.out_bytes += len;
+   zswap.pool_bytes += len;
+   pthread_mutex_unlock(&zswap_lock);
+
+   *retswptyp = PAGING_ZSWAP_SWPTYP;
+   *retswpoff = idx;
+   return 0;
+ }
+
+ /*
+  * zswap_load - decompress a pooled page into a MEMRAM frame
+  * @caller: caller
+  * @swpoff: swap offset of the page, its entry index
+  * @fpn: destination frame
+  *
+  * The entry is dropped, the page only lives in MEMRAM afterwards.
+  */
+ int zswap_load(struct pcb_t *caller, int swpoff, int fpn)
+ {
+   BYTE page[PAGING_PAGESZ];
+   int ret = -1;
+
+   pthread_mutex_lock(&zswap_lock);
+   if (swpoff >= 0 && swpoff < zswap.nr_entries && zswap.entries[swpoff].used &&
+       zswap_entry_read(swpoff, page) == 0 &&
+       MEMPHY_write_page(caller->mram, fpn, page) == 0)
+   {
+     zswap_entry_free(swpoff);
+     zswap.hits++;
+     ret = 0;
+   }
+   pthread_mutex_unlock(&zswap_lock);
+
+   return ret;
+ }
+
+ /*
+  * zswap_dup - give a new owner its own copy of a pooled page
+  * @caller: caller
+  * @mm: new owner
+  * @pgn: page number in the new owner
+  * @swptyp: swap type, updated when the copy lands on a device
+  * @swpoff: entry of the pooled page, updated to the copy
+  *
+  * The compressed bytes are copied, no page is decompressed unless the
+  * pool has no room and the copy has to go to a swap device.
+  */
+ static int __zswap_dup(struct pcb_t *caller, struct mm_struct *mm, int pgn,
+                        int *swptyp, int *swpoff)
+ {
+   BYTE page[PAGING_PAGESZ];
+   struct zswap_entry *src, *ze;
+   int idx, chunk = -1, fpn;
+
+   if (*swpoff < 0 || *swpoff >= zswap.nr_entries || !zswap.entries[*swpoff].used)
+     return -1;
+   src = &zswap.entries[*swpoff];
+
+   if ((idx = zswap_entry_alloc()) >= 0 &&
+       (src->chunk < 0 || (chunk = zswap_chunk_alloc(DIV_ROUND_UP(src->len, ZSWAP_CHUNK))) >= 0))
+   {
+     ze = &zswap.entries[idx];
+     *ze = *src;
+     ze->chunk = chunk;
+     ze->seq = zswap.seq++;
+     ze->mm = mm;
+     ze->pgn = pgn;
+     if (chunk >= 0)
+       memcpy(&zswap.arena[chunk * ZSWAP_CHUNK], &zswap.arena[src->chunk * ZSWAP_CHUNK], src->len);
+     zswap.pool_bytes += ze->len;
+     *swpoff = idx;
+     return 0;
+   }
+
+   /* No room in the pool, the copy goes to a swap device */
+   if (zswap_entry_read(*swpoff, page) != 0 ||
+       swap_get_freefp(caller, swptyp, &fpn) != 0)
+     return -1;
+   if (MEMPHY_write_page(swap_device(caller, *swptyp), fpn, page) != 0)
+   {
+     swap_put_freefp(caller, *swptyp, fpn);
+     return -1;
+   }
+   *swpoff = fpn;
+
+   return 0;
+ }
+
+ int zswap_dup(struct pcb_t *caller, struct mm_struct *mm, int pgn,
+               int *swptyp, int *swpoff)
+ {
+   int ret;
+
+   pthread_mutex_lock(&zswap_lock);
+   ret = __zswap_dup(caller, mm, pgn, swptyp, swpoff);
+   pthread_mutex_unlock(&zswap_lock);
+
+   return ret;
+ }
+
+ /*
+  * zswap_invalidate - drop a pooled page that is no longer needed
+  */
+ int zswap_invalidate(int swpoff)
+ {
+   int ret = -1;
+
+   pthread_mutex_lock(&zswap_lock);
+   if (swpoff >= 0 && swpoff < zswap.nr_entries && zswap.entries[swpoff].used)
+   {
+     zswap_entry_free(swpoff);
+     ret = 0;
+   }
+   pthread_mutex_unlock(&zswap_lock);
+
+   return ret;
+ }
+
+ /*
+  * zswap_miss - account a swap-in that had to read a swap device
+  */
+ void zswap_miss(void)
+ {
+   if (!zswap_enabled())
+     return;
+
+   pthread_mutex_lock(&zswap_lock);
+   zswap.misses++;
+   pthread_mutex_unlock(&zswap_lock);
+ }
+
+ /*
+  * zswap_stats - print pool usage, compression ratio and hit rate
+  */
+ int zswap_stats(void)
+ {
+   unsigned long loads;
+   int it, pooled = 0;
+
+   if (!zswap_enabled() || zswap.stored == 0)
+     return -1;
+
+   pthread_mutex_lock(&zswap_lock);
+   loads = zswap.hits + zswap.misses;
+   for (it = 0; it < zswap.nr_entries; it++)
+     pooled += zswap.entries[it].used;
+
+   printf("zswap: stored %lu pages (%lu same filled), %lu rejected, %lu written back\n",
+          zswap.stored, zswap.same_filled, zswap.rejected, zswap.written_back);
+   printf("zswap: pool holds %d pages in %lu of %d bytes",
+          pooled, zswap.pool_bytes, zswap.nr_chunks * ZSWAP_CHUNK);
+   if (zswap.out_bytes > 0)
+     printf(", compression ratio %.2f", (double)zswap.in_bytes / zswap.out_bytes);
+   printf("\n");
+   printf("zswap: swap-in hits %lu, misses %lu", zswap.hits, zswap.misses);
+   if (loads > 0)
+     printf(", hit rate %.1f%%", 100.0 * zswap.hits / loads);
+   printf("\n");
+   pthread_mutex_unlock(&zswap_lock);
+
+   return 0;
+ }
+
+ // #endif
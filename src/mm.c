@@ -9,6 +9,7 @@
  #include <stdlib.h>
  #include <stdio.h>
  #include <string.h> //for memset
+ #include <pthread.h>
  /*
   * init_pte - Initialize PTE entry - Page Table Entry
   * @pte    : target page table entry (PTE)
@@ -63,8 +64,9 @@
   */
  int pte_set_swap(uint32_t *pte, int swptyp, int swpoff)
  {
-   SETBIT(*pte, PAGING_PTE_PRESENT_MASK);
+   CLRBIT(*pte, PAGING_PTE_PRESENT_MASK);
    SETBIT(*pte, PAGING_PTE_SWAPPED_MASK);
+   CLRBIT(*pte, PAGING_PTE_DIRTY_MASK);
  
    SETVAL(*pte, swptyp, PAGING_PTE_SWPTYP_MASK, PAGING_PTE_SWPTYP_LOBIT);
    SETVAL(*pte, swpoff, PAGING_PTE_SWPOFF_MASK, PAGING_PTE_SWPOFF_LOBIT);
@@ -81,12 +83,52 @@
  {
    SETBIT(*pte, PAGING_PTE_PRESENT_MASK);
    CLRBIT(*pte, PAGING_PTE_SWAPPED_MASK);
+   CLRBIT(*pte, PAGING_PTE_DIRTY_MASK); /* fresh copy, clean until written */
  
+   /* Drop the swap offset bits above the FPN */
+   CLRBIT(*pte, PAGING_PTE_SWPOFF_MASK);
    SETVAL(*pte, fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
  
    return 0;
  }
  
+ /*
+  * pte_set_reserve - Set PTE entry for an allocated page without a frame
+  * @pte   : target page table entry (PTE)
+  */
+ int pte_set_reserve(uint32_t *pte)
+ {
+   CLRBIT(*pte, PAGING_PTE_PRESENT_MASK);
+   CLRBIT(*pte, PAGING_PTE_SWAPPED_MASK);
+   SETBIT(*pte, PAGING_PTE_RESERVE_MASK);
+ 
+   return 0;
+ }
+ 
+ /*
+  * vmap_reserve_range - reserve a range of page at aligned address
+  * @caller : process call
+  * @addr   : start address which is aligned to pagesz
+  * @pgnum  : num of reserved page
+  *
+  * No frame is taken, the first access of a page faults one in.
+  */
+ int vmap_reserve_range(struct pcb_t *caller, int addr, int pgnum)
+ {
+   int pgn = PAGING_PGN(addr);
+   int pgit;
+ 
+   if (!caller || addr < 0 || pgnum < 0 || pgn + pgnum > PAGING_MAX_PGN)
+     return -1; // invalid parameter
+ 
+   for (pgit = 0; pgit < pgnum; ++pgit) {
+     caller->mm->pgd[pgn + pgit] = 0;
+     pte_set_reserve(&caller->mm->pgd[pgn + pgit]);
+   }
+ 
+   return 0;
+ }
+ 
  /*
   * vmap_page_range - map a range of page at aligned address
   */
@@ -144,18 +186,54 @@
    /* Tracking for later page replacement activities (if needed)
     * Enqueue new usage page */
    for (int i = 0; i < mapped_pages; ++i) {
-     enlist_pgn_node(&caller->mm->fifo_pgn, pgn + i);
+     enlist_pgn_node(caller->mm, pgn + i);
    }
  
    return 0;
  }
  
+ /*
+  * enlist_frame_run - append a run of contiguous frames to a frame list
+  * @tail   : tail pointer of the list
+  * @fpn    : first frame of the run
+  * @num    : number of frames
+  */
+ static struct framephy_struct **enlist_frame_run(struct framephy_struct **tail, int fpn, int num)
+ {
+   int i;
+ 
+   for (i = 0; i < num; i++) {
+     struct framephy_struct *fp = malloc(sizeof(struct framephy_struct));
+     fp->fpn = fpn + i;
+     fp->fp_next = NULL;
+     fp->owner = NULL;
+     *tail = fp;
+     tail = &fp->fp_next;
+   }
+ 
+   return tail;
+ }
+ 
+ /*
+  * free_frame_list - release the nodes (not the frames) of a frame list
+  */
+ static void free_frame_list(struct framephy_struct *fp)
+ {
+   while (fp) {
+     struct framephy_struct *next = fp->fp_next;
+     free(fp);
+     fp = next;
+   }
+ }
+ 
  /*
   * alloc_pages_range - allocate req_pgnum of frame in ram
   * @caller    : caller
   * @req_pgnum : request page num
   * @frm_lst   : frame list
-  * don't know if it works
+  *
+  * Frames are taken from the buddy allocator as large as possible blocks,
+  * so the list is made of physically contiguous runs.
   */
  int alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_struct **frm_lst)
  {
@@ -163,42 +241,45 @@
      return -1; // invalid parameter
    }
  
-   int pgit, fpn;
-   struct framephy_struct *newfp_str = NULL;
+   struct memphy_struct *mram = caller->mram;
+   struct framephy_struct **tail = frm_lst;
+   int remain = req_pgnum;
+   int order, fpn, i;
+ 
+   *frm_lst = NULL;
+ 
+   /* Prefer one block covering the whole request, the unused tail goes back */
+   for (order = 0; order < MEMPHY_MAX_ORDER && (1 << order) < req_pgnum; order++)
+     ;
+   if (order < MEMPHY_MAX_ORDER && MEMPHY_get_freefp_order(mram, order, &fpn) == 0) {
+     for (i = req_pgnum; i < (1 << order); i++)
+       MEMPHY_put_freefp(mram, fpn + i);
+     enlist_frame_run(tail, fpn, req_pgnum);
+     return 0;
+   }
  
-   /* TODO: allocate the page
-   //caller-> ...
-   //frm_lst-> ...
-   */
-   newfp_str = malloc(sizeof(struct framephy_struct));
-   *frm_lst = newfp_str; // Hope this work
+   /* Otherwise gather the largest blocks still available */
+   order = MEMPHY_MAX_ORDER - 1;
+   while (remain > 0) {
+     while (order > 0 && (1 << order) > remain)
+       order--;
  
-   for (pgit = 0; pgit < req_pgnum; pgit++) {
-     /* TODO: allocate the page
-      */
-     if (MEMPHY_get_freefp(caller->mram, &fpn) == 0) {
-       newfp_str->fpn = fpn;
+     if (MEMPHY_get_freefp_order(mram, order, &fpn) == 0) {
+       tail = enlist_frame_run(tail, fpn, 1 << order);
+       remain -= 1 << order;
+     }
+     else if (order > 0) {
+       order--;
      }
      else { // TODO: ERROR CODE of obtaining somes but not enough frames
-       struct framephy_struct *fpit = *frm_lst;
-       struct framephy_struct *temp = NULL;
- 
-       while (fpit) {
-         temp = fpit;
-         MEMPHY_put_freefp(caller->mram,fpit->fpn); //add back to free_fp_lst
-         fpit = fpit->fp_next;
-         free(temp);
-       }
+       struct framephy_struct *fpit;
+ 
+       for (fpit = *frm_lst; fpit; fpit = fpit->fp_next)
+         MEMPHY_put_freefp(mram, fpit->fpn); //add back to free area
+       free_frame_list(*frm_lst);
        *frm_lst = NULL;
        return -3000;
      }
- 
-     if (pgit < req_pgnum - 1) {
-       newfp_str->fp_next = malloc(sizeof(struct framephy_struct));
-       newfp_str = newfp_str->fp_next;
-     } else {
-       newfp_str->fp_next = NULL;
-     }
    }
  
    return 0;
@@ -242,6 +323,7 @@
    /* it leaves the case of memory is enough but half in ram, half in swap
     * do the swaping all to swapper to get the all in ram */
    vmap_page_range(caller, mapstart, incpgnum, frm_lst, ret_rg);
+   free_frame_list(frm_lst);
  
    return 0;
  }
@@ -255,19 +337,12 @@
  int __swap_cp_page(struct memphy_struct *mpsrc, int srcfpn,
                     struct memphy_struct *mpdst, int dstfpn)
  {
-   int cellidx;
-   int addrsrc, addrdst;
-   for (cellidx = 0; cellidx < PAGING_PAGESZ; cellidx++)
-   {
-     addrsrc = srcfpn * PAGING_PAGESZ + cellidx;
-     addrdst = dstfpn * PAGING_PAGESZ + cellidx;
+   BYTE page[PAGING_PAGESZ];
  
-     BYTE data;
-     MEMPHY_read(mpsrc, addrsrc, &data);
-     MEMPHY_write(mpdst, addrdst, data);
-   }
+   if (MEMPHY_read_page(mpsrc, srcfpn, page) != 0)
+     return -1;
  
-   return 0;
+   return MEMPHY_write_page(mpdst, dstfpn, page);
  }
  
  /*
@@ -280,16 +355,18 @@
  {
    struct vm_area_struct *vma0 = malloc(sizeof(struct vm_area_struct));
  
+   pthread_mutex_init(&mm->mm_lock, NULL);
    mm->pgd = malloc(PAGING_MAX_PGN * sizeof(uint32_t));
    memset(mm->pgd, 0, PAGING_MAX_PGN * sizeof(uint32_t)); //add to handle unknown init pte value
    /* By default the owner comes with at least one vma */
    vma0->vm_id = 0;
    vma0->vm_start = 0;
-   vma0->vm_end = PAGING_MAX_PGN * PAGING_PAGESZ; 
+   vma0->vm_end = vma0->vm_start; /* grows with sbrk */
    vma0->sbrk = vma0->vm_start;
   //  struct vm_rg_struct *first_rg = init_vm_rg(vma0->vm_start, vma0->vm_end);
   //  enlist_vm_rg_node(&vma0->vm_freerg_list, first_rg);
    vma0->vm_freerg_list = NULL;  //no free_region
+   memset(&vma0->vm_freerg_idx, 0, sizeof(struct vm_rg_index));
    /* TODO update VMA0 next */
    vma0->vm_next = NULL;
  
@@ -297,7 +374,18 @@
    vma0->vm_mm = mm;
  
    /* TODO: update mmap */
-   mm->mmap = vma0;
+   mm->mmap = NULL;
+   mm->mm_rb = NULL;
+   vma_link(mm, vma0);
+   mm->fifo_pgn = NULL;
+   mm->nr_resident = 0;
+ 
+   mm->ra_win = 0;
+   mm->ra_prev_pgn = mm->ra_next_pgn = -1;
+   mm->ra_hit = mm->ra_miss = 0;
+   mm->hp_fault = mm->hp_split = 0;
+   memset(&mm->io_ring, 0, sizeof(mm->io_ring));
+   mm_list_add(mm, caller);
  
    return 0;
  }
@@ -321,8 +409,9 @@
    return 0;
  }
  
- int enlist_pgn_node(struct pgn_t **plist, int pgn)
+ int enlist_pgn_node(struct mm_struct *mm, int pgn)
  {
+   struct pgn_t **plist = &mm->fifo_pgn;
    struct pgn_t *pnode = malloc(sizeof(struct pgn_t));
    struct pgn_t *cur = *plist;
  
@@ -337,10 +426,70 @@
    pnode->pgn = pgn;
    pnode->pg_next = *plist;
    *plist = pnode;
+   mm->nr_resident += HPAGE_WEIGHT(mm->pgd[pgn]);
+ 
+   return 0;
+ }
+ 
+ int delist_pgn_node(struct mm_struct *mm, int pgn)
+ {
+   struct pgn_t **it = &mm->fifo_pgn;
+ 
+   while (*it) {
+     if ((*it)->pgn == pgn) {
+       struct pgn_t *pnode = *it;
+ 
+       *it = pnode->pg_next;
+       free(pnode);
+       mm->nr_resident -= HPAGE_WEIGHT(mm->pgd[pgn]);
+       return 0;
+     }
+     it = &(*it)->pg_next;
+   }
+ 
+   return -1; // not in the list
+ }
+ 
+ int enlist_rmap_node(struct rmap_struct **rmlist, struct mm_struct *mm, int pgn)
+ {
+   struct rmap_struct *rnode = malloc(sizeof(struct rmap_struct));
+ 
+   rnode->mm = mm;
+   rnode->pgn = pgn;
+   rnode->rm_next = *rmlist;
+   *rmlist = rnode;
  
    return 0;
  }
  
+ int delist_rmap_node(struct rmap_struct **rmlist, struct mm_struct *mm, int pgn)
+ {
+   struct rmap_struct **it = rmlist;
+ 
+   while (*it) {
+     if ((*it)->mm == mm && (*it)->pgn == pgn) {
+       struct rmap_struct *rnode = *it;
+ 
+       *it = rnode->rm_next;
+       free(rnode);
+       return 0;
+     }
+     it = &(*it)->rm_next;
+   }
+ 
+   return -1; // not in the list
+ }
+ 
+ void free_rmap_list(struct rmap_struct **rmlist)
+ {
+   while (*rmlist) {
+     struct rmap_struct *rnode = *rmlist;
+ 
+     *rmlist = rnode->rm_next;
+     free(rnode);
+   }
+ }
+ 
  int print_list_fp(struct framephy_struct *ifp)
  {
    struct framephy_struct *fp = ifp;
@@ -3,11 +3,13 @@
 #include "sched.h"
 #include "loader.h"
 #include "mm.h"
+#include "syscall.h"
 
 #include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
 
 #ifdef CFS_SCHED
 #include <time.h>
@@ -24,6 +26,17 @@ static uint32_t completed_processes = 0;
 #ifdef MM_PAGING
 static int memramsz;
 static int memswpsz[PAGING_MAX_MMSWP];
+/* Default priorities follow the device order, as swapon does */
+static int memswppri[PAGING_MAX_MMSWP] = { -1, -2, -3, -4 };
+static int zswapsz; /* compressed swap pool, off by default */
+static int hugepage; /* huge pages for large untouched runs, off by default */
+static int wmark_low, wmark_high; /* kswapd watermarks in frames, off by default */
+static int pff_faults, pff_window; /* load control threshold, off by default */
+/* Device cost models, entry 0 is MEMRAM then one per MEMSWP */
+static struct {
+	int set;
+	int access, page, seek;
+} memlat[PAGING_MAX_MMSWP + 1];
 
 struct mmpaging_ld_args {
 	/* A dispatched argument struct to compact many-fields passing to loader */
@@ -49,6 +62,15 @@ struct cpu_args {
 	int id;
 };
 
+/* The process ran its last instruction and paid off its memory stall */
+static int proc_finished(struct pcb_t * proc) {
+#ifdef MM_PAGING
+	if (proc->mem_ticks >= MEMPHY_SLOT_TICKS)
+		return 0;
+#endif
+	return proc->pc == proc->code->size;
+}
+
 #ifdef CFS_SCHED
 static clock_t start_time;
 
@@ -71,7 +93,7 @@ static void * cfs_cpu_routine(void * args) {
                 next_slot(timer_id);
                 continue; /* First load failed. skip dummy load */
             }
-        } else if (proc->pc == proc->code->size) {
+        } else if (proc_finished(proc)) {
             /* The process has finished its job */
             proc->finish_time = current_time();
             proc->cpu_burst_time += executed_time;
@@ -86,12 +108,25 @@ static void * cfs_cpu_routine(void * args) {
                 id, proc->pid, proc->niceness, proc->vruntime);
             printf("\t      Waiting time: %u, Turnaround time: %u, CPU burst time: %u\n",
                 proc->waiting_time, proc->turnaround_time, proc->cpu_burst_time);
+#ifdef MM_PAGING
+            if (proc->mm && (proc->mm->ra_hit || proc->mm->ra_miss))
+                printf("\t      Swap readahead hits: %lu, misses: %lu\n",
+                    proc->mm->ra_hit, proc->mm->ra_miss);
+            if (proc->mm && proc->mm->hp_fault)
+                printf("\t      Huge pages mapped: %lu, split: %lu\n",
+                    proc->mm->hp_fault, proc->mm->hp_split);
+            if (proc->mem_stall)
+                printf("\t      Memory stall: %u slots\n", proc->mem_stall);
+#endif
             
             /* Update vruntime based on actual execution time */
             if (executed_time > 0) {
                 update_vruntime(proc, executed_time);
             }
             
+#ifdef MM_PAGING
+            free_pbc_mem(proc);
+#endif
             free(proc);
             proc = get_proc();
             time_left = 0;
@@ -104,6 +139,7 @@ static void * cfs_cpu_routine(void * args) {
             }
 
             /* The process has done its job in current time slice or has been preempted */
+            proc->ru.ru_nivcsw++;
             printf("\tCPU %d: Put process %2d to run queue (niceness: %d, vruntime: %f)\n",
                 id, proc->pid, proc->niceness, proc->vruntime);
             
@@ -161,7 +197,7 @@ static void * cpu_routine(void * args) {
                 continue; /* First load failed. skip dummy load */
             }
             executed_time = 0;
-		} else if (proc->pc == proc->code->size) {
+		} else if (proc_finished(proc)) {
 			/* The process has finish it job */
 			proc->finish_time = current_time();
 			proc->cpu_burst_time += executed_time;
@@ -179,7 +215,20 @@ static void * cpu_routine(void * args) {
 #endif
 			printf("Waiting time: %u, Turnaround time: %u, CPU burst time: %u\n",
 				proc->waiting_time, proc->turnaround_time, proc->cpu_burst_time);
+#ifdef MM_PAGING
+			if (proc->mm && (proc->mm->ra_hit || proc->mm->ra_miss))
+				printf("\t      Swap readahead hits: %lu, misses: %lu\n",
+					proc->mm->ra_hit, proc->mm->ra_miss);
+			if (proc->mm && proc->mm->hp_fault)
+				printf("\t      Huge pages mapped: %lu, split: %lu\n",
+					proc->mm->hp_fault, proc->mm->hp_split);
+			if (proc->mem_stall)
+				printf("\t      Memory stall: %u slots\n", proc->mem_stall);
+#endif
 			
+#ifdef MM_PAGING
+			free_pbc_mem(proc);
+#endif
 			free(proc);
 			proc = get_proc();
 			time_left = 0;
@@ -187,6 +236,7 @@ static void * cpu_routine(void * args) {
 		} else if (time_left == 0) {
 			/* The process has done its job in current time slot */
 			proc->cpu_burst_time += executed_time;
+			proc->ru.ru_nivcsw++;
 			
 			printf("\tCPU %d: Put process %2d to run queue\n",
 				id, proc->pid);
@@ -227,6 +277,7 @@ static void * ld_routine(void * args) {
     struct memphy_struct* mram = ((struct mmpaging_ld_args *)args)->mram;
     struct memphy_struct** mswp = ((struct mmpaging_ld_args *)args)->mswp;
     struct memphy_struct* active_mswp = ((struct mmpaging_ld_args *)args)->active_mswp;
+    int active_mswp_id = ((struct mmpaging_ld_args *)args)->active_mswp_id;
     struct timer_id_t * timer_id = ((struct mmpaging_ld_args *)args)->timer_id;
 #else
     struct timer_id_t * timer_id = (struct timer_id_t*)args;
@@ -250,12 +301,16 @@ static void * ld_routine(void * args) {
         proc->mram = mram;
         proc->mswp = mswp;
         proc->active_mswp = active_mswp;
+        proc->active_mswp_id = active_mswp_id;
+        proc->mem_ticks = 0;
+        proc->mem_stall = 0;
 #endif
         proc->arrival_time = current_time();
         proc->cpu_burst_time = 0;
         proc->finish_time = 0;
         proc->waiting_time = 0;
         proc->turnaround_time = 0;
+        memset(&proc->ru, 0, sizeof(proc->ru));
         
         printf("\tLoaded a process at %s, PID: %d", ld_processes.path[i], proc->pid);
 #ifdef MLQ_SCHED
@@ -283,6 +338,95 @@ static void * ld_routine(void * args) {
     pthread_exit(NULL);
 }
 
+/*
+ * read_directive - apply a tuning directive of the config file
+ *   swappri P0 P1 P2 P3 : MEMSWP priorities, higher is used first and
+ *                         devices of equal priority are striped
+ *   zswap SIZE          : compressed pool of SIZE bytes in front of MEMSWP
+ *   memlat DEV A P [S]  : cost model of DEV (ram, swp0..swp3) in ticks,
+ *                         MEMPHY_SLOT_TICKS make a slot. A per access, P
+ *                         per page transfer and, when given, S per page
+ *                         of cursor travel on a now sequential device
+ *   hugepage            : map aligned untouched runs of HPAGE_NR pages
+ *                         as huge pages
+ *   watermark LOW HIGH  : run kswapd, woken when fewer than LOW frames
+ *                         of MEMRAM are free, it swaps out pages until
+ *                         HIGH frames are free
+ *   loadctl FAULTS [SLOTS]: hold a process back from the CPUs while more
+ *                         than FAULTS major faults happen in SLOTS time
+ *                         slots, PFF_WINDOW by default
+ *   sysstat [time]      : count the calls of each system call, and with
+ *                         time the host time spent in them
+ */
+static void read_directive(const char * line) {
+	char key[32];
+
+	if (sscanf(line, "%31s", key) != 1)
+		return;
+	if (!strcmp(key, "sysstat")) {
+		char opt[32];
+		syscall_stat_enable(1, sscanf(line, "%*s %31s", opt) == 1 &&
+			!strcmp(opt, "time"));
+		return;
+	}
+#ifdef MM_PAGING
+	if (!strcmp(key, "swappri")) {
+		sscanf(line, "%*s %d %d %d %d", &memswppri[0], &memswppri[1],
+			&memswppri[2], &memswppri[3]);
+		return;
+	}
+	if (!strcmp(key, "zswap")) {
+		sscanf(line, "%*s %d", &zswapsz);
+		return;
+	}
+	if (!strcmp(key, "hugepage")) {
+		hugepage = 1;
+		return;
+	}
+	if (!strcmp(key, "watermark")) {
+		if (sscanf(line, "%*s %d %d", &wmark_low, &wmark_high) != 2 ||
+		    wmark_low <= 0 || wmark_high < wmark_low) {
+			printf("Bad watermark directive: %s", line);
+			wmark_low = wmark_high = 0;
+		}
+		return;
+	}
+	if (!strcmp(key, "loadctl")) {
+		pff_window = PFF_WINDOW;
+		if (sscanf(line, "%*s %d %d", &pff_faults, &pff_window) < 1 ||
+		    pff_faults <= 0 || pff_window <= 0) {
+			printf("Bad loadctl directive: %s", line);
+			pff_faults = 0;
+		}
+		return;
+	}
+	if (!strcmp(key, "memlat")) {
+		char dev[8];
+		int id = -1, access, page, seek = -1;
+
+		if (sscanf(line, "%*s %7s %d %d %d", dev, &access, &page, &seek) >= 3) {
+			if (!strcmp(dev, "ram"))
+				id = 0;
+			else if (sscanf(dev, "swp%d", &id) == 1 &&
+				 id >= 0 && id < PAGING_MAX_MMSWP)
+				id++;
+			else
+				id = -1;
+		}
+		if (id < 0) {
+			printf("Bad memlat directive: %s", line);
+			return;
+		}
+		memlat[id].set = 1;
+		memlat[id].access = access;
+		memlat[id].page = page;
+		memlat[id].seek = seek;
+		return;
+	}
+#endif
+	printf("Unknown config directive: %s\n", key);
+}
+
 static void read_config(const char * path) {
 	FILE * file;
 	if ((file = fopen(path, "r")) == NULL) {
@@ -318,6 +462,18 @@ static void read_config(const char * path) {
 #endif
 #endif
 
+	/* Optional directives, one per line, between the memory config and
+	 * the process list. A directive line starts with its keyword.
+	 */
+	int c;
+	char line[256];
+	while ((c = fgetc(file)) != EOF) {
+		ungetc(c, file);
+		if (!isalpha(c) || fgets(line, sizeof(line), file) == NULL)
+			break;
+		read_directive(line);
+	}
+
 	// Allocate memory for both prio and niceness arrays
 	ld_processes.prio = (unsigned long*)malloc(sizeof(unsigned long) * num_processes);
 	ld_processes.niceness = (int*)malloc(sizeof(int) * num_processes);
@@ -377,21 +533,50 @@ int main(int argc, char * argv[]) {
 
 	struct memphy_struct mram;
 	struct memphy_struct mswp[PAGING_MAX_MMSWP];
+	struct memphy_struct *mswp_tbl[PAGING_MAX_MMSWP];
 
 	/* Create MEM RAM */
 	init_memphy(&mram, memramsz, rdmflag);
+	if (memlat[0].set)
+		MEMPHY_set_latency(&mram, memlat[0].access, memlat[0].page,
+			memlat[0].seek);
 
         /* Create all MEM SWAP */ 
 	int sit;
-	for(sit = 0; sit < PAGING_MAX_MMSWP; sit++)
+	for(sit = 0; sit < PAGING_MAX_MMSWP; sit++) {
+#if defined(MM_SWAP_MMAP) && defined(MM_SWAP_FILE)
+		/* Sparse host file per device, holes cost nothing until written */
+		char swpfile[100];
+		snprintf(swpfile, sizeof(swpfile), MM_SWAP_FILE, sit);
+#ifdef MM_SWAP_PERSIST
+		init_memphy_mmap(&mswp[sit], memswpsz[sit], rdmflag, swpfile, 1);
+#else
+		init_memphy_mmap(&mswp[sit], memswpsz[sit], rdmflag, swpfile, 0);
+#endif
+#elif defined(MM_SWAP_MMAP)
+		init_memphy_mmap(&mswp[sit], memswpsz[sit], rdmflag, NULL, 0);
+#else
 	       init_memphy(&mswp[sit], memswpsz[sit], rdmflag);
+#endif
+		mswp[sit].swp_prio = memswppri[sit];
+		if (memlat[sit + 1].set)
+			MEMPHY_set_latency(&mswp[sit], memlat[sit + 1].access,
+				memlat[sit + 1].page, memlat[sit + 1].seek);
+		mswp_tbl[sit] = &mswp[sit];
+	}
+	zswap_init(zswapsz);
+	hpage_enable(hugepage);
+	if (wmark_low > 0)
+		kswapd_init(&mram, wmark_low, wmark_high);
+	if (pff_faults > 0)
+		pff_init(pff_faults, pff_window);
 
 	/* In Paging mode, it needs passing the system mem to each PCB through loader*/
 	struct mmpaging_ld_args *mm_ld_args = malloc(sizeof(struct mmpaging_ld_args));
 
 	mm_ld_args->timer_id = ld_event;
 	mm_ld_args->mram = (struct memphy_struct *) &mram;
-	mm_ld_args->mswp = (struct memphy_struct**) &mswp;
+	mm_ld_args->mswp = mswp_tbl;
 	mm_ld_args->active_mswp = (struct memphy_struct *) &mswp[0];
         mm_ld_args->active_mswp_id = 0;
 #endif
@@ -425,6 +610,9 @@ int main(int argc, char * argv[]) {
 
 	/* Stop timer */
 	stop_timer();
+#ifdef MM_PAGING
+	kswapd_exit();
+#endif
 	
 	if (completed_processes > 0) {
 		float avg_waiting_time = (float)total_waiting_time / completed_processes;
@@ -443,5 +631,21 @@ int main(int argc, char * argv[]) {
 		printf("============================\n");
 	}
 
+#ifdef MM_PAGING
+	if (mram.nr_alloc > 0) {
+		printf("\n=== Physical Memory (MEMRAM) ===\n");
+		MEMPHY_buddyinfo(&mram);
+		printf("============================\n");
+	}
+	if (zswap_enabled() && zswap_stats() == 0)
+		printf("============================\n");
+	if (reclaim_stats() == 0)
+		printf("============================\n");
+	if (pff_stats() == 0)
+		printf("============================\n");
+#endif
+	if (syscall_stats() == 0)
+		printf("============================\n");
+
 	return 0;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "../include/queue.h"
 #include "sched.h"
+#include "mm.h"
 #include <pthread.h>
 
 #include <stdlib.h>
@@ -98,6 +99,12 @@ struct pcb_t *get_cfs_proc(void) {
     }
 
     RBNode *minNode = getMinNode(cfs_ready_tree);
+#ifdef MM_PAGING
+    /* Held back by load control, it only runs when nothing else is ready.
+     * It stays in the tree, the next node in order runs instead */
+    if (minNode->data->proc == pff_held() && (minNode->right || minNode->parent))
+        minNode = minNode->right ? minimumRightSubTree(minNode) : minNode->parent;
+#endif
 	re_calculate_time_slice(minNode);
     struct pcb_t *proc = minNode->data->proc;
     deleteNode(&cfs_ready_tree, minNode->data);
@@ -228,6 +235,38 @@ void remove_from_queue(struct queue_t *q, struct pcb_t *proc){
 	q->size--;
 }
 
+/* dequeue() that passes over @skip, which keeps its place in the queue */
+static struct pcb_t *mlq_dequeue(struct queue_t *q, struct pcb_t *skip)
+{
+	int max_index = -1;
+	for (int i = 0; i < q->size; i++) {
+		if (q->proc[i] == skip)
+			continue;
+		if (max_index < 0 || q->proc[i]->priority > q->proc[max_index]->priority)
+			max_index = i;
+	}
+	if (max_index < 0)
+		return NULL;
+
+	struct pcb_t *proc = q->proc[max_index];
+	for (int i = max_index; i < q->size - 1; i++)
+		q->proc[i] = q->proc[i + 1];
+	q->size--;
+	return proc;
+}
+
+#ifdef MM_PAGING
+/* The ready queue a process waits in, -1 when it is not ready */
+static int mlq_find(struct pcb_t *proc)
+{
+	for (int prio = 0; prio < MAX_PRIO; prio++)
+		for (int i = 0; i < mlq_ready_queue[prio].size; i++)
+			if (mlq_ready_queue[prio].proc[i] == proc)
+				return prio;
+	return -1;
+}
+#endif
+
 struct pcb_t * dequeue_wrapper(void* queue){ //for syscall
 	pthread_mutex_lock(&queue_lock);
 	struct pcb_t * proc = dequeue((struct queue_t*)queue);
@@ -248,8 +287,14 @@ void enqueue_wrapper(void* queue, struct pcb_t *proc){ //for syscall
 struct pcb_t *get_mlq_proc(void)
 {
 	struct pcb_t *proc = NULL;
+	struct pcb_t *held = NULL;
 	pthread_mutex_lock(&queue_lock);
 
+#ifdef MM_PAGING
+	/* Held back by load control, it only runs when nothing else is ready */
+	held = pff_held();
+#endif
+
 	//fix all slot equal 0
 	if(slot[MAX_PRIO-1] == 0){
 		for (int i = 0; i < MAX_PRIO; i++)
@@ -261,11 +306,23 @@ struct pcb_t *get_mlq_proc(void)
 	{
 		if (!empty(&mlq_ready_queue[prio]) && slot[prio] > 0)
 		{
-			proc = dequeue(&mlq_ready_queue[prio]);
+			proc = mlq_dequeue(&mlq_ready_queue[prio], held);
+			if (proc == NULL)
+				continue;
 			slot[prio]--;
 			break;
 		}
 	}
+#ifdef MM_PAGING
+	/* Dispatched as a fallback it still uses up a slot of its queue */
+	int held_prio = (proc == NULL && held) ? mlq_find(held) : -1;
+	if (held_prio >= 0) {
+		remove_from_queue(&mlq_ready_queue[held_prio], held);
+		if (slot[held_prio] > 0)
+			slot[held_prio]--;
+		proc = held;
+	}
+#endif
 	if(proc!=NULL) enqueue(&running_list, proc); //add proc to running_list
 	pthread_mutex_unlock(&queue_lock);
 	return proc;
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2025 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* Sierra release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+#include "common.h"
+#include "syscall.h"
+#include "loader.h"
+#include "sched.h"
+#include "timer.h"
+#include "mm.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * __sys_fork - duplicate the caller into a new process
+ *
+ * The child continues right after the syscall with the same registers
+ * and a copy-on-write copy of the address space. The child PID is
+ * returned in a1.
+ */
+int __sys_fork(struct pcb_t *caller, struct sc_regs *regs)
+{
+    struct pcb_t *child = malloc(sizeof(struct pcb_t));
+
+    *child = *caller;
+    child->pid = alloc_pid();
+
+    /* Own copy of the code, both processes go on from the same pc */
+    child->code = malloc(sizeof(struct code_seg_t));
+    child->code->size = caller->code->size;
+    child->code->text = malloc(sizeof(struct inst_t) * caller->code->size);
+    memcpy(child->code->text, caller->code->text,
+           sizeof(struct inst_t) * caller->code->size);
+    child->page_table = calloc(1, sizeof(struct page_table_t));
+
+#ifdef MM_PAGING
+    if (__dup_mm(caller, child) != 0) {
+        free(child->page_table);
+        free(child->code->text);
+        free(child->code);
+        free(child);
+        return -1;
+    }
+    /* The copy is paid by the parent */
+    child->mem_ticks = 0;
+    child->mem_stall = 0;
+#endif
+
+    child->arrival_time = current_time();
+    child->cpu_burst_time = 0;
+    child->finish_time = 0;
+    child->waiting_time = 0;
+    child->turnaround_time = 0;
+    memset(&child->ru, 0, sizeof(child->ru));
+
+    printf("\tProcess %d forked process %d\n", caller->pid, child->pid);
+    add_proc(child);
+
+    regs->a1 = child->pid;
+    return 0;
+}
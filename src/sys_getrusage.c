@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2025 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* Sierra release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+#include "common.h"
+#include "syscall.h"
+#include "mm.h"
+
+/*
+ * __sys_getrusage - resource usage of the caller
+ * a1: region the usage is stored to, as the uint32_t fields of
+ * struct rusage_struct in order, little endian, cut to the region size.
+ *
+ * No call blocks in this simulator, a process only leaves the CPU at the
+ * end of its time slice, so voluntary switches stay 0.
+ */
+int __sys_getrusage(struct pcb_t *caller, struct sc_regs *regs)
+{
+    struct rusage_struct ru;
+    struct vm_rg_struct *rg;
+    const uint32_t *field = (const uint32_t *)&ru;
+    int off, size;
+
+    if (__getrusage(caller, &ru) != 0)
+        return -1;
+#ifdef MLQ_SCHED
+    ru.ru_prio = caller->prio;
+#endif
+#ifdef CFS_SCHED
+    ru.ru_prio = caller->niceness;
+    ru.ru_vruntime = (uint32_t)caller->vruntime;
+#endif
+
+    printf("\tProcess %d usage: rss %u swap %u minflt %u majflt %u "
+           "in %u out %u slots %u nvcsw %u nivcsw %u\n",
+           caller->pid, ru.ru_rss, ru.ru_nswap, ru.ru_minflt, ru.ru_majflt,
+           ru.ru_inblock, ru.ru_oublock, ru.ru_utime, ru.ru_nvcsw, ru.ru_nivcsw);
+
+    rg = get_symrg_byid(caller->mm, regs->a1);
+    if (rg == NULL || rg->rg_start < 0 || rg->rg_end <= rg->rg_start)
+        return -1;
+
+    size = rg->rg_end - rg->rg_start;
+    if (size > (int)sizeof(ru))
+        size = sizeof(ru);
+    for (off = 0; off < size; off++)
+        if (__write(caller, 0, regs->a1, off, (BYTE)(field[off / 4] >> (8 * (off % 4)))) != 0)
+            return -1;
+
+    return 0;
+}
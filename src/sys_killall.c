@@ -12,6 +12,7 @@
 #include "syscall.h"
 #include "stdio.h"
 #include "libmem.h"
+#include "mm.h"
 #include "queue.h"
 #include "string.h"
 #include <stdlib.h>
@@ -104,6 +105,7 @@ int __sys_killall(struct pcb_t *caller, struct sc_regs* regs) {
                 if (strcmp(target->path, my_proc_name) == 0) {
                     printf("\tProcess %d has been killed\n", target->pid);
                     target->pc = target->code->size; // Đánh dấu tiến trình đã hoàn thành
+                    free_pbc_mem(target); // return its frames and swap frames
                     free(target); // Giải phóng bộ nhớ của tiến trình
                     killed_count++;
                 }
@@ -126,6 +128,7 @@ int __sys_killall(struct pcb_t *caller, struct sc_regs* regs) {
             if (strcmp(target->path, my_proc_name) == 0) {
                 printf("\tProcess %d has been killed\n", target->pid);
                 target->pc = target->code->size; // Đánh dấu tiến trình đã hoàn thành
+                free_pbc_mem(target); // return its frames and swap frames
                 free(target); // Giải phóng bộ nhớ của tiến trình
                 killed_count++;
             }
@@ -13,7 +13,8 @@
 int __sys_listsyscall(struct pcb_t *caller, struct sc_regs* reg)
 {
    for (int i = 0; i < syscall_table_size; i++)
-       printf("%s\n",sys_call_table[i]); 
+       if (sys_call_handlers[i] != __sys_ni_syscall) // skip the holes
+           printf("%s\n",sys_call_table[i]); 
 
    return 0;
 }
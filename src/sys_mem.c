@@ -15,10 +15,13 @@
  
  //typedef char BYTE;
  
- int __sys_memmap(struct pcb_t *caller, struct sc_regs* regs)
+ /* One memory operation, buf is the page of SYSMEM_IO_READP/WRITEP */
+ static int memmap_op(struct pcb_t *caller, struct sc_regs* regs, BYTE *buf)
  {
     int memop = regs->a1;
+    struct memphy_struct *swp;
     BYTE value;
+    uint64_t word;
  
     switch (memop) {
     case SYSMEM_MAP_OP:
@@ -34,6 +37,20 @@
                 return -1; 
              }
              break;
+    case SYSMEM_SWPOUT_OP: /* the device is named, queued copies may go to several */
+             swp = swap_device(caller, regs->a4);
+             if (swp == NULL ||
+                 __swap_cp_page(caller->mram, regs->a2, swp, regs->a3) != 0) {
+                return -1; 
+             }
+             break;
+    case SYSMEM_SWPIN_OP:
+             swp = swap_device(caller, regs->a4);
+             if (swp == NULL ||
+                 __swap_cp_page(swp, regs->a3, caller->mram, regs->a2) != 0) {
+                return -1; 
+             }
+             break;
     case SYSMEM_IO_READ:
              if (MEMPHY_read(caller->mram, regs->a2, &value) != 0) {
                 return -1; 
@@ -45,6 +62,29 @@
                 return -1; 
              }
              break;
+    case SYSMEM_IO_READW: /* a4 bytes, low half in a3, high half in a5 */
+             if (MEMPHY_read_word(caller->mram, regs->a2, regs->a4, &word) != 0) {
+                return -1; 
+             }
+             regs->a3 = (uint32_t)word;
+             regs->a5 = (uint32_t)(word >> 32);
+             break;
+    case SYSMEM_IO_WRITEW:
+             word = ((uint64_t)regs->a5 << 32) | regs->a3;
+             if (MEMPHY_write_word(caller->mram, regs->a2, regs->a4, word) != 0) {
+                return -1; 
+             }
+             break;
+    case SYSMEM_IO_READP:
+             if (buf == NULL || MEMPHY_read_page(caller->mram, regs->a2, buf) != 0) {
+                return -1; 
+             }
+             break;
+    case SYSMEM_IO_WRITEP:
+             if (buf == NULL || MEMPHY_write_page(caller->mram, regs->a2, buf) != 0) {
+                return -1; 
+             }
+             break;
     default:
              printf("Memop code: %d\n", memop);
              break;
@@ -52,4 +92,49 @@
     
     return 0;
  }
+ 
+ /* Run the operations queued on the ring of the caller, in order,
+  * return the number of completions filled */
+ static int memmap_drain(struct pcb_t *caller)
+ {
+    struct memmap_ring *ring = &caller->mm->io_ring;
+    struct memmap_sqe *sqe;
+    struct memmap_cqe *cqe;
+    struct sc_regs regs;
+    int nr = 0;
+ 
+    if (ring->sq_tail - ring->sq_head > MEMMAP_RING_SZ)
+             return -1;
+ 
+    while (ring->sq_head != ring->sq_tail) {
+             sqe = &ring->sq[ring->sq_head++ % MEMMAP_RING_SZ];
+             cqe = &ring->cq[ring->cq_tail++ % MEMMAP_RING_SZ];
+             regs.a1 = sqe->op;
+             regs.a2 = sqe->a2;
+             regs.a3 = sqe->a3;
+             regs.a4 = sqe->a4;
+             regs.a5 = sqe->a5;
+             cqe->ret = memmap_op(caller, &regs, sqe->buf);
+             cqe->val = ((uint64_t)regs.a5 << 32) | regs.a3;
+             cqe->res = sqe->res;
+             nr++;
+    }
+    syscall_stat_ops(17, nr);
+ 
+    return nr;
+ }
+ 
+ int __sys_memmap(struct pcb_t *caller, struct sc_regs* regs)
+ {
+    int nr;
+ 
+    if (regs->a1 == SYSMEM_IO_SUBMIT) {
+             if ((nr = memmap_drain(caller)) < 0)
+                return -1;
+             regs->a2 = nr;
+             return 0;
+    }
+ 
+    return memmap_op(caller, regs, NULL);
+ }
  
\ No newline at end of file
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2025 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* Sierra release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+#include "common.h"
+#include "syscall.h"
+#include "mm.h"
+
+/*
+ * __sys_shmget - find or create the shared memory segment KEY
+ * a1: key, a2: size in bytes. The segment ID is returned in a1.
+ */
+int __sys_shmget(struct pcb_t *caller, struct sc_regs *regs)
+{
+    int segid = __shmget(caller, regs->a1, regs->a2);
+
+    if (segid < 0)
+        return -1;
+
+    regs->a1 = segid;
+    return 0;
+}
+
+/*
+ * __sys_shmat - map the shared memory segment KEY at region a2
+ * Programs cannot keep the ID shmget returns, segments are named by key.
+ */
+int __sys_shmat(struct pcb_t *caller, struct sc_regs *regs)
+{
+    return __shmat(caller, regs->a1, regs->a2);
+}
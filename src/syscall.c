@@ -10,6 +10,8 @@
 
 #include "syscall.h"
 #include "common.h"
+#include <pthread.h>
+#include <time.h>
 
 #define __SYSCALL(nr, sym) extern int __##sym(struct pcb_t*,struct sc_regs*);
 #include "syscalltbl.lst"
@@ -26,6 +28,29 @@ const char* sys_call_table[] = {
 #undef  __SYSCALL
 const int syscall_table_size = sizeof(sys_call_table)/sizeof(char*);
 
+/*
+ * The handlers, indexed by system call number. syscalltbl.sh fills the
+ * holes of the table with sys_ni_syscall.
+ */
+#define __SYSCALL(nr, sym) [nr] = __##sym,
+const sys_call_ptr_t sys_call_handlers[] = {
+#include "syscalltbl.lst"
+};
+#undef  __SYSCALL
+
+#define NR_syscalls (sizeof(sys_call_handlers)/sizeof(sys_call_ptr_t))
+
+/* Calls and host time of each system call, kept while sysstat is on.
+ * The time is only read with `sysstat time`, it differs between runs. */
+int sys_call_stat_on;
+static int sys_call_stat_timed;
+static struct {
+	unsigned long calls;
+	unsigned long long ns;
+	unsigned long ops;
+} sys_call_stat[NR_syscalls];
+static pthread_mutex_t sys_call_stat_lock = PTHREAD_MUTEX_INITIALIZER;
+
 int __sys_ni_syscall(struct pcb_t *caller, struct sc_regs *regs)
 {
    /*
@@ -35,12 +60,84 @@ int __sys_ni_syscall(struct pcb_t *caller, struct sc_regs *regs)
    return 0;
 }
 
-#define __SYSCALL(nr, sym) case nr: return __##sym(caller,regs);
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Dispatch and account one call, the slow path of syscall() */
+static int syscall_stat(struct pcb_t *caller, uint32_t nr, struct sc_regs* regs)
+{
+	unsigned long long start = sys_call_stat_timed ? now_ns() : 0;
+	int ret = sys_call_handlers[nr](caller, regs);
+	unsigned long long ns = sys_call_stat_timed ? now_ns() - start : 0;
+
+	pthread_mutex_lock(&sys_call_stat_lock);
+	sys_call_stat[nr].calls++;
+	sys_call_stat[nr].ns += ns;
+	pthread_mutex_unlock(&sys_call_stat_lock);
+
+	return ret;
+}
+
 int syscall(struct pcb_t *caller, uint32_t nr, struct sc_regs* regs)
 {
-	switch (nr) {
-	#include "syscalltbl.lst"
-	default: return __sys_ni_syscall(caller, regs);
-	}
+	if (nr >= NR_syscalls)
+		return __sys_ni_syscall(caller, regs);
+	if (sys_call_stat_on)
+		return syscall_stat(caller, nr, regs);
+	return sys_call_handlers[nr](caller, regs);
 };
 
+/* Start counting, and timing when @timed, before the CPUs run */
+void syscall_stat_enable(int on, int timed)
+{
+	sys_call_stat_on = on;
+	sys_call_stat_timed = on && timed;
+}
+
+/* Count the operations a batching call such as memmap ran */
+void syscall_stat_ops(uint32_t nr, unsigned long ops)
+{
+	if (!sys_call_stat_on || nr >= NR_syscalls)
+		return;
+	pthread_mutex_lock(&sys_call_stat_lock);
+	sys_call_stat[nr].ops += ops;
+	pthread_mutex_unlock(&sys_call_stat_lock);
+}
+
+/*
+ * syscall_stats - print the calls and time of each system call used
+ */
+int syscall_stats(void)
+{
+	uint32_t nr;
+
+	if (!sys_call_stat_on)
+		return -1;
+
+	printf("system calls:\n");
+	pthread_mutex_lock(&sys_call_stat_lock);
+	for (nr = 0; nr < NR_syscalls; nr++) {
+		if (sys_call_stat[nr].calls == 0)
+			continue;
+		if (sys_call_stat_timed)
+			printf("%-20s calls %8lu, %10.3f ms, %8.1f ns per call\n",
+				sys_call_table[nr], sys_call_stat[nr].calls,
+				sys_call_stat[nr].ns / 1e6,
+				(double)sys_call_stat[nr].ns / sys_call_stat[nr].calls);
+		else
+			printf("%-20s calls %8lu\n",
+				sys_call_table[nr], sys_call_stat[nr].calls);
+		if (sys_call_stat[nr].ops != 0)
+			printf("%-20s ops   %8lu, %8.1f ops per call\n", "",
+				sys_call_stat[nr].ops,
+				(double)sys_call_stat[nr].ops / sys_call_stat[nr].calls);
+	}
+	pthread_mutex_unlock(&sys_call_stat_lock);
+
+	return 0;
+}
@@ -31,8 +31,16 @@ grep -E "^[0-9]+[[:space:]]+" "$infile" | sort -n | {
 
 	while read nr name native ; do
 
+		# Fill the holes, the table is indexed by syscall number
+		while [ $nxt -lt $nr ]; do
+			echo "__SYSCALL($nxt, sys_ni_syscall)"
+			nxt=$((nxt + 1))
+		done
+
 		if [ -n "$native" ]; then
 			echo "__SYSCALL($nr, $native)"
+		else
+			echo "__SYSCALL($nr, sys_ni_syscall)"
 		fi
 		nxt=$((nr + 1))
 	done
@@ -17,6 +17,8 @@ static uint64_t _time;
 static int timer_started = 0;
 static int timer_stop = 0;
 
+static void (*slot_hook)(void) = NULL;
+
 
 static void * timer_routine(void * args) {
 	while (!timer_stop) {
@@ -41,6 +43,11 @@ static void * timer_routine(void * args) {
 			pthread_mutex_unlock(&temp->id.event_lock);
 		}
 
+		/* No device is running, work between slots sees a quiet system */
+		if (slot_hook != NULL) {
+			slot_hook();
+		}
+
 		/* Increase the time slot */
 		_time++;
 		
@@ -80,6 +87,10 @@ uint64_t current_time() {
 	return _time;
 }
 
+void set_slot_hook(void (*hook)(void)) {
+	slot_hook = hook;
+}
+
 void start_timer() {
 	timer_started = 1;
 	pthread_create(&_timer, NULL, timer_routine, NULL);